@@ -16,6 +16,8 @@
 
 void sysPasserenLogicalSem(state_t *excState, support_t *sup);
 void sysVerhogenLogicalSem(state_t *excState, support_t *sup);
+void sysVerhogenAllLogicalSem(state_t *excState, support_t *sup);
+void sysBarrierLogical(state_t *excState, support_t *sup);
 void initALSL();
 
 #endif
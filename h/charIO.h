@@ -0,0 +1,32 @@
+#ifndef CHAR_IO
+#define CHAR_IO
+
+/**
+ * @file charIO.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Nucleus Character I/O Module.
+ * @date 2025-05-02
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/const.h"
+#include "../h/types.h"
+
+extern int termTxSem[DEVPERINT];
+extern int termRxSem[DEVPERINT];
+
+extern void initCharIO();
+extern int isCharIOSem(int *sem);
+extern int termTxPut(int termNum, char *src, int len);
+extern int termTxInterrupt(int termNum, unsigned int statusCode);
+extern int termRxLineReady(int termNum);
+extern int termRxGet(int termNum, char *dst);
+extern int termRxInterrupt(int termNum, unsigned int statusCode);
+extern int termTxBusy(int termNum);
+extern int termTxEmpty(int termNum);
+extern void xferStart(int devIdx, char *buf, int len);
+extern int xferInterrupt(int devIdx, unsigned int statusCode);
+
+#endif
@@ -13,8 +13,8 @@
 #define BYTELEN       8
 #define MAXINT        2147483647
 
-#define MAXPROC       20        /* Maximum number of concurrent processes */
 #define QUANTUM       5000      /* Each process gets a time slice of 5 miliseconds */
+#define SCHED_POLICY  rrPolicy  /* Ready queue policy (see scheduler.h) */
 
 /* Status Register Bit Definitions */
 #define ZERO_MASK    (0U)
@@ -155,20 +155,68 @@
 #define BIOSDATAPAGE    0x0FFFF000
 #define	PASSUPVECTOR	  0x0FFFF900
 #define STACKTOP        0x20001000  /* Nucleus stack size is one page (4KB) */
+
+/* Multiprocessor support. NUM_CPUS must match the number of processors in the
+ * machine configuration. Processor n saves the exception state at BIOSDATAPAGE
+ * + n * sizeof(state_t) and reads its Pass Up Vector at PASSUPVECTOR + n * 16.
+ * The Makefiles pass NUM_CPUS (make NUM_CPUS=4 builds a four-processor kernel) */
+#ifndef NUM_CPUS
+#define NUM_CPUS        1
+#endif
+#define CPU0            0           /* The processor that runs Nucleus services */
+#define CPU_STATE(cpu)  ((state_t *)BIOSDATAPAGE + (cpu))
+#define CPU_PASSUPVECTOR(cpu) ((passupvector_t *)PASSUPVECTOR + (cpu))
+#define IRT_BASE        0x10000300  /* Interrupt Routing Table, lines 2-7 */
+#define IRT_ENTRIES     48
+#define IRT_TO_CPU0     1           /* Static routing to processor 0 */
+#define IPIINT          0           /* Inter-processor interrupt line */
+#define CPU_INBOX       0x10000400  /* Oldest message received (write to acknowledge it) */
+#define CPU_OUTBOX      0x10000404  /* Message to send to the processors in bits 16-23 */
+#define IPI_TO(cpu)     (1U << (16 + (cpu)))
+#define IPI_TLB_FLUSH   1           /* Message: flush your TLB and acknowledge */
+#define IDLE_POLL       500         /* An idle processor looks for work every 0.5ms */
+#define UNLOCKED        0
+#define LOCKED          1
 #define DEVREG          0x10000054 /* All 40 device registers are located in low memory starting at 0x1000.0054 */
 
 /* Constants for VM management */
 #define MAXPAGES            32                /* 32 pages per U-proc */
 #define STACKPAGE           (MAXPAGES - 1)    /* Page 31 for stack */
 #define KUSEGSHARE_PAGES    32                /* Number of pages in shared logical address space */
-#define MAX_UPROCS          8                 /* Maximum number of concurrent user processes */
+#define MAX_UPROCS          16                /* Support structures: U-procs, forked U-procs and threads (at most MAX_ASID) */
+#define MAX_ASID            63                /* Largest ASID the EntryHi ASID field holds */
+#define ALSL_BUCKETS        32                /* Hash buckets of the Active Logical Semaphore List (power of 2) */
+/* Every U-proc and thread runs on its own support structure (MAX_UPROCS of
+ * them) and waits on at most one logical semaphore, whose node is freed as soon
+ * as it is woken, so the ALSL never needs more waiter nodes or non-empty
+ * per-address queues than that */
+#define ALSL_NODES          MAX_UPROCS        /* Logical semaphore waiters/queues the ALSL can hold */
 #define UPROC_PC            0x800000B0        /* .text start */
 #define UPROC_SP            0xC0000000        /* RAM top */
+#define UPROC_CPU_LIMIT     0                 /* CPU time (microseconds) a U-proc may use, 0 for no limit */
+#define UPROC_CPU_BUDGET    0                 /* CPU time a U-proc may use per period, 0 for no cap */
+#define UPROC_CPU_PERIOD    0                 /* Period of UPROC_CPU_BUDGET (microseconds) */
 
 #define DISK_DMA_BASE   (RAMSTART + 32 * PAGESIZE)      /* Starting physical address of DMA buffers for disk device */
 #define FLASH_DMA_BASE  (DISK_DMA_BASE + 8 * PAGESIZE)  /* Starting physical address of DMA buffers for flash device */
 #define SWAP_POOL_BASE  (FLASH_DMA_BASE + 8 * PAGESIZE) /* Starting physical address of the Swap Pool */
-#define SWAP_POOL_SIZE  (2 * MAX_UPROCS)                /* Size of the Swap Pool */
+#define SWAP_POOL_MAX   (2 * MAX_UPROCS)                /* Largest Swap Pool; its size is set by the RAM size */
+
+/* Pages at the top of RAM used as stacks by init() and the Delay Daemon.
+ * Daemon stacks and the U-procs' Support Level pages are allocated below them */
+#define RESERVED_STACK_PAGES  2
+#define SUPPORT_PAGES         3 /* Pages of a U-proc: two handler stacks, DMA */
+
+/* Every U-proc is a process, next to init(), the Delay Daemon, up to one
+ * daemon per printer and, while the U-procs are launched, up to one image
+ * helper per flash device. The phase 1 tester sets its own MAXPROC */
+#ifndef MAXPROC
+#define MAXPROC         (MAX_UPROCS + 2 * DEVPERINT + 2) /* Maximum number of concurrent processes */
+#endif
+
+#if MAX_UPROCS > MAX_ASID
+#error "MAX_UPROCS needs more ASIDs"
+#endif
 
 #define ASID_UNOCCUPIED -1                          /* Marker for free Swap Pool frame */
 #define ASID_SHIFT      6
@@ -186,7 +234,8 @@
 
 #define IS_SHARED_VPN(vpn)      ((vpn) >= VPN_KUSEGSHARE_BASE)
 
-#define KUSEG_BASE_SECTOR       (MAX_UPROCS * MAXPAGES)   /* Base sector (backing store) of shared pages */
+#define BACKING_SECTORS_MAX     (MAX_UPROCS * MAXPAGES)   /* Private pages DISK0 may hold; the shared pages follow them */
+#define NO_SECTOR               -1                        /* Private page not on the backing store */
 
 /* constant for .aout file format */
 #define TEXT_FILE_SIZE_OFFSET   0x0014
@@ -238,6 +287,8 @@ For a 32-bit EntryLo, the format is:
 #define	WAITCLOCK		      7	    /* delay on the clock semaphore */
 #define	GETSUPPORTPTR     8	    /* return support structure ptr. */
 
+#define CREATE_SIBLING    1     /* SYS1 a3: make the new process a sibling of the caller */
+
 /* Support Level system call codes */
 #define TERMINATE         9     /* Terminate U-proc */
 #define GETTOD            10    /* Get Time of Day */
@@ -251,10 +302,51 @@ For a 32-bit EntryLo, the format is:
 #define DELAY             18    /* Delay the calling U-proc for some number of seconds */
 #define PSEMLOGICAL       19    /* P a logical (in kuseg_share) semaphore */
 #define VSEMLOGICAL       20    /* V a logical (in kuseg_share) semaphore */
+#define PRINTFLUSH        21    /* Wait for the U-proc's spooled print jobs */
+#define PRINTSTATS        22    /* Read a printer's utilisation statistics */
+#define VSEMLOGICALALL    23    /* Wake all U-procs blocked on a logical semaphore */
+#define BARRIERLOGICAL    24    /* Wait on a logical (in kuseg_share) barrier */
+#define PIPESEND          25    /* Write bytes into a kernel pipe */
+#define PIPERECV          26    /* Read bytes from a kernel pipe */
+#define DELAYUS           27    /* Delay the calling U-proc for some number of microseconds */
+#define EXEC              28    /* Replace the calling U-proc's image with a flash image */
+#define FORK              29    /* Create a copy-on-write copy of the calling U-proc */
+#define THREADCREATE      30    /* Start a thread in the calling U-proc's address space */
+#define THREADJOIN        31    /* Wait for a thread of the calling U-proc to terminate */
+
+/* Extended Nucleus system call codes (kernel-mode only). They start at 41 so
+ * that they never collide with the Support Level system call codes */
+#define NUCLEUS_EXT_BASE  41
+#define WRITETERMBUF      41    /* buffer characters for a terminal transmitter */
+#define READTERMBUF       42    /* take a line from a terminal's read-ahead buffer */
+#define XFERSTRING        43    /* send a string to a printer or terminal */
+#define WAITUNTIL         44    /* sleep until a TOD deadline (microseconds) */
+#define PASSERENTIMED     45    /* P with a timeout (microseconds) */
+
+/* SYS45 return values */
+#define SEM_ACQUIRED      0     /* the P completed */
+#define SEM_TIMEOUT       1     /* the timeout expired first; the P was undone */
+
+#define WAITIOANY         46    /* wait for the first of several devices */
+#define WAITANY_MAX       8     /* most devices a single SYS46 may wait on */
+
+#define CREATEQUOTA       47    /* create process with a CPU time quota */
+#define GETUSERTIME       48    /* get cpu time used in user mode */
+#define GETKERNELTIME     49    /* get cpu time used in kernel mode */
+#define GETINTRTIME       50    /* get time spent serving interrupts */
 
 /* Device-specific constants */
-#define PRINTER_MAXLEN    128    /* Max length for SYS11 */
-#define TERMINAL_MAXLEN   128    /* Max length for SYS12 */
+#define PRINTER_MAXLEN    128    /* Chunk size SYS11 streams through the spooler */
+#define TERMINAL_MAXLEN   128    /* Chunk size SYS12 streams through the ring */
+#define TERM_TXBUF_SIZE   256    /* Capacity of a terminal transmit ring buffer */
+#define TERM_RXBUF_SIZE   128    /* Capacity of a terminal receive ring buffer */
 #define BACKING_DISK      0      /* DISK0 is used for backing store */
+#define SPOOL_JOBS        16     /* Number of print jobs the spooler can hold */
+#define PRINT_POOLED      1      /* SYS11 a3: print on any idle printer */
+#define NUM_PIPES         8      /* Number of kernel pipes (SYS25/SYS26) */
+#define PIPE_SIZE         1024   /* Capacity of a kernel pipe in bytes */
+#define PIPE_MAXLEN       PAGESIZE  /* Max bytes moved by one SYS25/SYS26 */
+#define ADL_SIZE          MAXPROC  /* Sleeping U-procs the Active Delay List can hold */
+#define MAX_THREADS       MAX_UPROCS  /* Threads (running or not joined) SYS30 can track */
 
 #endif
@@ -15,5 +15,6 @@
 
 void initADL();
 void sysDelay(state_t *excState,support_t *sup);
+void sysDelayMicro(state_t *excState, support_t *sup);
 
 #endif
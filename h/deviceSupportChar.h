@@ -16,5 +16,6 @@
 void sysWriteToPrinter(state_t *excState, support_t *sup);
 void sysWriteToTerminal(state_t *excState, support_t *sup);
 void sysReadFromTerminal(state_t *excState, support_t *sup);
+void termFlush(support_t *sup);
 
 #endif
@@ -17,6 +17,7 @@ int diskOperation(unsigned int diskNum, unsigned int sectorNum,
                   memaddr frameAddr, unsigned int op);
 int flashOperation(unsigned int flashNum, unsigned int blockNum,
                    memaddr frameAddr, unsigned int op);
+int readImagePages(unsigned int flashNum, memaddr dmaBuf);
 
 void sysDiskWrite(state_t *excState, support_t *sup);
 void sysDiskRead(state_t *excState, support_t *sup);
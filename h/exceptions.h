@@ -16,5 +16,6 @@
 extern void copyState(state_t *dest, state_t *src);
 extern void generalExceptionHandler();
 void sysTerminateProc(state_t *savedExcState);
+void stopOverLimit(state_t *savedExcState);
 
 #endif
@@ -15,7 +15,11 @@
 #include "../h/types.h"
 
 extern int masterSemaphore;
+extern int liveUProcs;
 extern int supportDeviceSem[NUMDEVICES];
 extern pte_t globalPgTbl[KUSEGSHARE_PAGES];
 
+void initUProcState(state_t *state, int asid);
+void initSupportStruct(support_t *sup);
+
 #endif
@@ -16,10 +16,12 @@
 
 extern int procCnt;
 extern int softBlockCnt;
-extern pcb_PTR readyQueue;
-extern pcb_PTR currentProc;
+extern pcb_PTR volatile currentProcs[NUM_CPUS];
 extern int deviceSem[NUMDEVICES + 1];
 
+/* The pcb running on the calling processor */
+#define currentProc (currentProcs[getPRID()])
+
 /***************************************************************/
 
 #endif
@@ -13,6 +13,8 @@
 
 #include "../h/types.h"
 
+extern cpu_t interruptTimes[NUM_CPUS];
+
 extern void interruptHandler(state_t *savedExcState);
 
 #endif
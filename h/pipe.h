@@ -0,0 +1,20 @@
+#ifndef PIPE
+#define PIPE
+
+/**
+ * @file pipe.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Pipe Module.
+ * @date 2025-05-06
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/types.h"
+
+void initPipes();
+void sysPipeSend(state_t *excState, support_t *sup);
+void sysPipeReceive(state_t *excState, support_t *sup);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef PRINT_SPOOLER_H
+#define PRINT_SPOOLER_H
+
+/**
+ * @file printSpooler.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Printer Spooler Module.
+ * @date 2025-05-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/types.h"
+
+void initSpooler();
+int spoolSubmit(int owner, int printer, char *src, unsigned int len,
+                int pooled);
+int spoolFlush(int owner);
+void sysPrintFlush(state_t *excState, support_t *sup);
+void sysPrintStats(state_t *excState, support_t *sup);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef QUOTA
+#define QUOTA
+
+/**
+ * @file quota.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the CPU Quota Module.
+ * @date 2025-05-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/const.h"
+#include "../h/types.h"
+
+extern void quotaSet(pcb_PTR p, quota_t *quota);
+extern void chargeCPU(pcb_PTR p, int user);
+extern int overLimit(pcb_PTR p);
+extern int overBudget(pcb_PTR p);
+extern void quotaThrottle(pcb_PTR p);
+extern unsigned int quotaSlice(pcb_PTR p, unsigned int quantum);
+
+#endif
@@ -11,12 +11,51 @@
  *
  */
 
+#include "../h/const.h"
 #include "../h/types.h"
 
-extern cpu_t quantumStartTime;
+/* Scheduling policy: the order of a ready queue and the length of time
+ * slices. The policy named by SCHED_POLICY in const.h is used. Every hook is
+ * called with interrupts disabled, possibly on any processor; enqueue,
+ * dequeue, remove and empty hold the lock of the queue.
+ * - sp_enqueue: insert a ready process into a queue.
+ * - sp_dequeue: remove the process to run next among those canRun accepts,
+ *   or return NULL.
+ * - sp_remove: remove a given process from a queue, or return NULL if it is
+ *   not there.
+ * - sp_empty: tell whether a queue holds no process.
+ * - sp_onBlock: the running process blocks on a semaphore.
+ * - sp_onWake: a blocked process is about to be made ready.
+ * - sp_onTick: the running process used up its time slice and is about to
+ *   be made ready.
+ * - sp_quantum: length (in microseconds) of a process's next time slice. */
+typedef struct schedPolicy_t {
+  void (*sp_enqueue)(pcb_PTR *queue, pcb_PTR p);
+  pcb_PTR (*sp_dequeue)(pcb_PTR *queue, int (*canRun)(pcb_PTR p));
+  pcb_PTR (*sp_remove)(pcb_PTR *queue, pcb_PTR p);
+  int (*sp_empty)(pcb_PTR queue);
+  void (*sp_onBlock)(pcb_PTR p);
+  void (*sp_onWake)(pcb_PTR p);
+  void (*sp_onTick)(pcb_PTR p);
+  unsigned int (*sp_quantum)(pcb_PTR p);
+} schedPolicy_t;
+
+extern schedPolicy_t SCHED_POLICY;
+
+extern cpu_t chargeStartTimes[NUM_CPUS];
+
+/* When the calling processor's current process was last charged for CPU time
+ * (see chargeCPU()), or the processor last entered the Nucleus while idle */
+#define chargeStartTime (chargeStartTimes[getPRID()])
 
 extern void switchContext(state_t *state);
 extern void loadContext(context_t *context);
+extern void initReadyQueues();
+extern void makeReady(pcb_PTR p);
+extern void wakeProc(pcb_PTR p);
+extern void preemptProc(pcb_PTR p);
+extern void blockProc(pcb_PTR p);
+extern pcb_PTR outReady(pcb_PTR p);
 extern void scheduler();
 
 #endif
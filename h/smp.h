@@ -0,0 +1,23 @@
+#ifndef SMP
+#define SMP
+
+/**
+ * @file smp.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Multiprocessor Module.
+ * @date 2025-05-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/const.h"
+#include "../h/types.h"
+
+extern void acquireLock(volatile unsigned int *lock);
+extern void releaseLock(volatile unsigned int *lock);
+extern void startCPUs();
+extern void tlbShootdown();
+extern void tlbSync();
+
+#endif
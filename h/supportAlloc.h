@@ -16,6 +16,9 @@
 
 support_t *supportAlloc();
 void supportDeallocate(support_t *sup);
-void initSupportFreeList();
+void initSupportFreeList(int numStructs);
+void initStackAlloc(memaddr bottom);
+memaddr pageAlloc();
+memaddr stackAlloc();
 
 #endif
@@ -0,0 +1,22 @@
+#ifndef THREAD
+#define THREAD
+
+/**
+ * @file thread.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Thread Module.
+ * @date 2025-05-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/types.h"
+
+void initThreads();
+int threadCount(int asid);
+int threadExit(support_t *sup);
+void sysThreadCreate(state_t *excState, support_t *sup);
+void sysThreadJoin(state_t *excState, support_t *sup);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TIMERS
+#define TIMERS
+
+/**
+ * @file timers.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Nucleus Timer Module.
+ * @date 2025-05-07
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/const.h"
+#include "../h/types.h"
+
+extern int timerSem;
+
+extern void initTimers();
+extern int isTimerSem(int *sem);
+extern void timerInsert(pcb_PTR p, cpu_t deadline);
+extern void timerCancel(pcb_PTR p);
+extern void timerInterrupt();
+
+#endif
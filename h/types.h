@@ -116,17 +116,52 @@ typedef struct pte_t {
 
 /* Swap Pool Entry structure */
 typedef struct spte_t {
-  int spte_asid; /* ASID (1-8) of the process that owns the page, -1 if free */
+  int spte_asid; /* ASID of a process mapping the page, 0: shared, -1: free */
   unsigned int spte_vpn; /* Virtual Page Number */
   pte_t *spte_pte;       /* Pointer to Page Table entry */
+  int spte_refs;         /* Number of processes mapping the frame */
+  int spte_dirty;        /* Changed since loaded, by a process that forked */
 } spte_t;
 
+/* Devices a U-proc is bound to. Several U-procs may share a device */
+typedef struct devBinding_t {
+  int b_flash;    /* flash device holding its image (0-7) */
+  int b_terminal; /* terminal for SYS12/SYS13 (0-7)        */
+  int b_printer;  /* printer for SYS11 (0-7)               */
+} devBinding_t;
+
+/* One device a SYS46 (WAITIOANY) caller waits on, named as for SYS5 */
+typedef struct ioWait_t {
+  int w_line; /* interrupt line (3-7)                     */
+  int w_dev;  /* device number (0-7)                      */
+  int w_read; /* TRUE to wait for a terminal read          */
+} ioWait_t;
+
+/* CPU time quota a SYS47 (CREATEQUOTA) caller gives the new process; 0
+ * disables a field. Times are in microseconds */
+typedef struct quota_t {
+  cpu_t q_limit;  /* total CPU time, after which the process is stopped */
+  cpu_t q_budget; /* CPU time allowed in each period                   */
+  cpu_t q_period; /* length of a period                                */
+} quota_t;
+
+/* Printer utilisation statistics kept by the print spooler */
+typedef struct printStats_t {
+  unsigned int ps_jobs;   /* jobs printed                          */
+  unsigned int ps_chars;  /* characters printed                    */
+  unsigned int ps_errors; /* jobs that ended with an error status  */
+  cpu_t ps_busyTime;      /* microseconds spent printing           */
+} printStats_t;
+
 typedef struct support_t {
   int           sup_asid;                   /* Process Id (asid) */
   state_t       sup_exceptState[2];         /* stored excpt states */
   context_t     sup_exceptContext[2];       /* pass up contexts */
   pte_t         sup_privatePgTbl[MAXPAGES]; /* Process Page Table (32 entries) */
   int           sup_privateSem;             /* Process's private semaphore */
+  memaddr       sup_stack[2];               /* Tops of the pass-up stacks */
+  memaddr       sup_dmaBuf;                 /* Private DMA page for SYS16/17 */
+  devBinding_t  sup_dev;                    /* Devices the U-proc is bound to */
 } support_t;
 
 /* process control block type */
@@ -144,12 +179,29 @@ typedef struct pcb_t {
   /* process status information */
   state_t         p_s;          /* processor state          */
   cpu_t           p_time;       /* cpu time used by proc    */
+  cpu_t           p_userTime;   /* of which in user mode    */
+  cpu_t           p_kernelTime; /* of which in kernel mode  */
   int             *p_semAdd;    /* pointer to sema4 on      */
                                 /* which process blocked    */
   
   /* support layer information */
   support_t       *p_supportStruct;
                                 /* ptr to support struct */
+
+  /* timed wait information */
+  int             p_timed;      /* TRUE while in the Nucleus */
+                                /* timer heap (SYS44/SYS45) */
+
+  /* multiprocessor information */
+  int             p_forward;    /* TRUE if p_s holds an      */
+                                /* exception for processor 0 */
+  int             p_killed;     /* TRUE if terminated while  */
+                                /* away from processor 0     */
+
+  /* cpu quota information */
+  quota_t         p_quota;      /* limits set at creation   */
+  cpu_t           p_periodStart;/* TOD the period began     */
+  cpu_t           p_periodUsed; /* cpu time used in period  */
 } pcb_t, *pcb_PTR;
 
 #endif
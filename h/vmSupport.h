@@ -14,9 +14,16 @@
 #include "../h/const.h"
 #include "../h/types.h"
 
-void initSwapStructs();
+int initSwapStructs();
+memaddr swapPoolEnd();
 void releaseFrames(int asid);
+void initBackingPages(support_t *sup, int numPages);
+int saveImageBlock(int flashNum, int blockNum, memaddr buf);
+void resetAddressSpace(support_t *sup, int numPages);
+void forkAddressSpace(support_t *parent, support_t *child);
+support_t *addrSpaceOwner(int asid);
 int isValidAddr(memaddr addr);
+int isValidRange(memaddr addr, unsigned int len);
 void uTLB_RefillHandler();
 void uTLB_ExceptionHandler();
 
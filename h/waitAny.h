@@ -0,0 +1,25 @@
+#ifndef WAIT_ANY
+#define WAIT_ANY
+
+/**
+ * @file waitAny.h
+ * @author Dang Truong
+ * @brief The externals declaration file for the Nucleus Wait-Any Module.
+ * @date 2025-05-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/const.h"
+#include "../h/types.h"
+
+extern int waitAnySem;
+
+extern void initWaitAny();
+extern int isWaitAnySem(int *sem);
+extern int waitAnyAdd(pcb_PTR p, int devIdx, int slot);
+extern void waitAnyCancel(pcb_PTR p);
+extern int waitAnyInterrupt(int devIdx, unsigned int statusCode);
+
+#endif
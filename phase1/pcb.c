@@ -55,10 +55,22 @@ HIDDEN void initPcb(pcb_PTR p) {
     p->p_s.s_reg[i] = 0;
   }
   p->p_time = 0;
+  p->p_userTime = 0;
+  p->p_kernelTime = 0;
   p->p_semAdd = NULL;
 
   /* support layer information */
   p->p_supportStruct = NULL;
+  p->p_timed = FALSE;
+  p->p_forward = FALSE;
+  p->p_killed = FALSE;
+
+  /* cpu quota information */
+  p->p_quota.q_limit = 0;
+  p->p_quota.q_budget = 0;
+  p->p_quota.q_period = 0;
+  p->p_periodStart = 0;
+  p->p_periodUsed = 0;
 }
 
 /**
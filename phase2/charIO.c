@@ -0,0 +1,452 @@
+/**
+ * @file charIO.c
+ * @author Dang Truong, Loc Pham
+ * @brief This module implements the Nucleus-side buffering for character
+ * devices. Each terminal transmitter owns a ring buffer that the Support Level
+ * fills through a single system call. The device interrupt handler then feeds
+ * the buffered characters to the transmitter one at a time, so the writer only
+ * blocks when the ring is full instead of once per character.
+ *
+ * Each terminal receiver owns a read-ahead ring buffer as well. Once a terminal
+ * has been read from, the interrupt handler keeps re-arming the receiver and
+ * stores incoming characters in the ring, so that complete lines are already
+ * waiting when the next read is issued.
+ *
+ * Finally, printers and terminal transmitters can be driven by a string
+ * transfer: the caller hands over a kernel buffer and blocks once, and the
+ * interrupt handler issues every following character itself, waking the caller
+ * only when the whole string has been sent or an error occurred.
+ * @date 2025-05-02
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/charIO.h"
+
+#include "../h/asl.h"
+#include "../h/initial.h"
+#include "../h/pcb.h"
+#include "../h/scheduler.h"
+
+/* Terminal transmit ring buffer */
+typedef struct txring_t {
+  char tx_buf[TERM_TXBUF_SIZE]; /* buffered characters                     */
+  int tx_head;                  /* index of the character on the wire      */
+  int tx_count;                 /* number of characters in the ring        */
+  int tx_busy;                  /* TRUE while the ring drives the device   */
+  unsigned int tx_error;        /* status of the last failed transmission  */
+} txring_t;
+
+/* Terminal receive (read-ahead) ring buffer */
+typedef struct rxring_t {
+  char rx_buf[TERM_RXBUF_SIZE]; /* received characters                     */
+  int rx_head;                  /* index of the oldest received character  */
+  int rx_count;                 /* number of characters in the ring        */
+  int rx_lines;                 /* number of complete lines in the ring    */
+  int rx_armed;                 /* TRUE while a RECEIVECHAR is outstanding */
+  unsigned int rx_error;        /* status of the last failed receipt       */
+} rxring_t;
+
+/* String transfer to a printer or terminal transmitter */
+typedef struct xfer_t {
+  char *x_buf;  /* kernel buffer holding the string       */
+  int x_len;    /* number of characters in the string     */
+  int x_pos;    /* index of the character on the wire     */
+  int x_active; /* TRUE while the transfer drives the device */
+} xfer_t;
+
+/* Index of a device in the transfer table: printers first, then terminals */
+#define XFER_IDX(devIdx) ((devIdx) - (PRNTINT - DISKINT) * DEVPERINT)
+
+HIDDEN txring_t txRing[DEVPERINT];
+HIDDEN rxring_t rxRing[DEVPERINT];
+HIDDEN xfer_t xfers[2 * DEVPERINT];
+
+/* Writers waiting for free space in a terminal's transmit ring */
+int termTxSem[DEVPERINT];
+
+/* Readers waiting for a complete line in a terminal's receive ring */
+int termRxSem[DEVPERINT];
+
+/**
+ * @brief Get the device register of a terminal.
+ *
+ * @param termNum Terminal number (0-7).
+ * @return Pointer to the terminal's device register.
+ */
+HIDDEN device_t *termDevice(int termNum) {
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+  return &busRegArea->devreg[(TERMINT - DISKINT) * DEVPERINT + termNum];
+}
+
+/**
+ * @brief Start transmitting the character at the head of a ring.
+ *
+ * @param termNum Terminal number (0-7).
+ * @param ring The terminal's transmit ring, which must not be empty.
+ */
+HIDDEN void transmitHead(int termNum, txring_t *ring) {
+  char c = ring->tx_buf[ring->tx_head];
+  termDevice(termNum)->t_transm_command = TRANSMITCHAR | (c << BYTELEN);
+}
+
+/**
+ * @brief Issue the current character of a string transfer to its device.
+ *
+ * @param devIdx Device index of a printer or terminal transmitter.
+ * @param xfer The device's active transfer.
+ */
+HIDDEN void transmitXferChar(int devIdx, xfer_t *xfer) {
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+  device_t *devreg = &busRegArea->devreg[devIdx];
+  char c = xfer->x_buf[xfer->x_pos];
+
+  if (devIdx < (TERMINT - DISKINT) * DEVPERINT) {
+    devreg->d_data0 = c;
+    devreg->d_command = PRINTCHR;
+  } else {
+    devreg->t_transm_command = TRANSMITCHAR | (c << BYTELEN);
+  }
+}
+
+/**
+ * @brief Issue a RECEIVECHAR command if the receive ring can take another
+ * character and no command is already outstanding.
+ *
+ * The receiver is left idle after an error until the error has been reported
+ * to a reader.
+ *
+ * @param termNum Terminal number (0-7).
+ * @param ring The terminal's receive ring.
+ */
+HIDDEN void armReceiver(int termNum, rxring_t *ring) {
+  if (!ring->rx_armed && ring->rx_error == 0 &&
+      ring->rx_count < TERM_RXBUF_SIZE) {
+    ring->rx_armed = TRUE;
+    termDevice(termNum)->t_recv_command = RECEIVECHAR;
+  }
+}
+
+/**
+ * @brief Unblock every process waiting on a Nucleus character I/O semaphore.
+ *
+ * The semaphore is only used as a wait queue, so it is reset to 0 once all
+ * waiters have been moved to the ready queue (as for the pseudo-clock).
+ *
+ * @param sem Pointer to the semaphore.
+ */
+HIDDEN void wakeAll(int *sem) {
+  pcb_PTR p;
+  while ((p = removeBlocked(sem)) != NULL) {
+    wakeProc(p);
+    softBlockCnt--;
+  }
+  *sem = 0;
+}
+
+/**
+ * @brief Initialize the character I/O buffers and their wait semaphores.
+ */
+void initCharIO() {
+  int i;
+  for (i = 0; i < DEVPERINT; i++) {
+    txRing[i].tx_head = 0;
+    txRing[i].tx_count = 0;
+    txRing[i].tx_busy = FALSE;
+    txRing[i].tx_error = 0;
+    termTxSem[i] = 0;
+
+    rxRing[i].rx_head = 0;
+    rxRing[i].rx_count = 0;
+    rxRing[i].rx_lines = 0;
+    rxRing[i].rx_armed = FALSE;
+    rxRing[i].rx_error = 0;
+    termRxSem[i] = 0;
+  }
+
+  for (i = 0; i < 2 * DEVPERINT; i++) {
+    xfers[i].x_buf = NULL;
+    xfers[i].x_len = 0;
+    xfers[i].x_pos = 0;
+    xfers[i].x_active = FALSE;
+  }
+}
+
+/**
+ * @brief Check whether a semaphore belongs to the character I/O module.
+ *
+ * Processes blocked on these semaphores are counted in softBlockCnt.
+ *
+ * @param sem Pointer to the semaphore.
+ * @return TRUE if the semaphore is a character I/O wait semaphore.
+ */
+int isCharIOSem(int *sem) {
+  return (sem >= termTxSem && sem < termTxSem + DEVPERINT) ||
+         (sem >= termRxSem && sem < termRxSem + DEVPERINT);
+}
+
+/**
+ * @brief Append characters to a terminal's transmit ring.
+ *
+ * Copies as many characters as currently fit in the ring and starts the
+ * transmitter if it was idle. A transmission error recorded by the interrupt
+ * handler is reported (and cleared) instead of accepting new characters.
+ *
+ * @param termNum Terminal number (0-7).
+ * @param src Kernel buffer holding the characters.
+ * @param len Number of characters to append.
+ * @return Number of characters accepted (0 if the ring is full), or the
+ * negated device status of a previous failed transmission.
+ */
+int termTxPut(int termNum, char *src, int len) {
+  txring_t *ring = &txRing[termNum];
+
+  if (ring->tx_error != 0) {
+    int error = -ring->tx_error;
+    ring->tx_error = 0;
+    return error;
+  }
+
+  int n = 0;
+  while (n < len && ring->tx_count < TERM_TXBUF_SIZE) {
+    int tail = (ring->tx_head + ring->tx_count) % TERM_TXBUF_SIZE;
+    ring->tx_buf[tail] = src[n];
+    ring->tx_count++;
+    n++;
+  }
+
+  xfer_t *xfer = &xfers[XFER_IDX((TERMINT - DISKINT) * DEVPERINT + termNum)];
+  if (!ring->tx_busy && !xfer->x_active && ring->tx_count > 0) {
+    /* The transmitter is idle: kick it off with the first character */
+    ring->tx_busy = TRUE;
+    transmitHead(termNum, ring);
+  }
+
+  return n;
+}
+
+/**
+ * @brief Feed the next buffered character after a transmit completion.
+ *
+ * Called by the device interrupt handler once the transmit interrupt has been
+ * acknowledged. On success the completed character is dropped from the ring
+ * and the next one is issued; on failure the ring is flushed and the status is
+ * kept for the next writer. Writers waiting for space are only woken once the
+ * ring has drained to half its capacity, so a writer streaming a long string
+ * is not rescheduled for every character.
+ *
+ * @param termNum Terminal number (0-7).
+ * @param statusCode The transmitter status read before the acknowledgement.
+ * @return TRUE if the completion belonged to the ring, FALSE if it belongs to
+ * a process waiting in SYS5.
+ */
+int termTxInterrupt(int termNum, unsigned int statusCode) {
+  txring_t *ring = &txRing[termNum];
+
+  if (!ring->tx_busy) {
+    return FALSE;
+  }
+
+  if ((statusCode & TERMINT_STATUS_MASK) == CHAR_TRANSMITTED) {
+    ring->tx_head = (ring->tx_head + 1) % TERM_TXBUF_SIZE;
+    ring->tx_count--;
+  } else {
+    /* Drop the pending output and remember the error for the next writer */
+    ring->tx_error = statusCode;
+    ring->tx_count = 0;
+  }
+
+  if (ring->tx_count > 0) {
+    transmitHead(termNum, ring);
+  } else {
+    ring->tx_busy = FALSE;
+  }
+
+  if (ring->tx_count <= TERM_TXBUF_SIZE / 2) {
+    wakeAll(&termTxSem[termNum]);
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Check whether a read on a terminal can be satisfied right away.
+ *
+ * The first call for a terminal starts the read-ahead: from then on, the
+ * receiver is kept armed by the interrupt handler.
+ *
+ * @param termNum Terminal number (0-7).
+ * @return TRUE if the receive ring holds a complete line, is full, or has an
+ * error to report; FALSE if a blocking reader has to wait.
+ */
+int termRxLineReady(int termNum) {
+  rxring_t *ring = &rxRing[termNum];
+  armReceiver(termNum, ring);
+  return ring->rx_lines > 0 || ring->rx_count == TERM_RXBUF_SIZE ||
+         ring->rx_error != 0;
+}
+
+/**
+ * @brief Take buffered input out of a terminal's receive ring.
+ *
+ * Copies the oldest line, including its newline, into dst. If no complete line
+ * is buffered, whatever has been received so far is copied instead (this is
+ * what a non-blocking read returns). A pending receive error is reported (and
+ * cleared) only once the characters received before it have been consumed.
+ *
+ * @param termNum Terminal number (0-7).
+ * @param dst Kernel buffer of at least TERM_RXBUF_SIZE characters.
+ * @return Number of characters copied, or the negated device status of a
+ * failed receipt.
+ */
+int termRxGet(int termNum, char *dst) {
+  rxring_t *ring = &rxRing[termNum];
+
+  if (ring->rx_count == 0 && ring->rx_error != 0) {
+    int error = -ring->rx_error;
+    ring->rx_error = 0;
+    armReceiver(termNum, ring);
+    return error;
+  }
+
+  int n = 0;
+  int done = FALSE;
+  while (ring->rx_count > 0 && !done) {
+    char c = ring->rx_buf[ring->rx_head];
+    ring->rx_head = (ring->rx_head + 1) % TERM_RXBUF_SIZE;
+    ring->rx_count--;
+    dst[n++] = c;
+    if (c == '\n') {
+      ring->rx_lines--;
+      done = TRUE;
+    }
+  }
+
+  /* Space has been freed: resume the read-ahead if it had stalled */
+  armReceiver(termNum, ring);
+  return n;
+}
+
+/**
+ * @brief Store a received character in the read-ahead ring.
+ *
+ * Called by the device interrupt handler once the receive interrupt has been
+ * acknowledged. The receiver is re-armed as long as the ring has space, and
+ * readers are woken when a line is complete, the ring fills up, or the
+ * receipt failed.
+ *
+ * @param termNum Terminal number (0-7).
+ * @param statusCode The receiver status read before the acknowledgement.
+ * @return TRUE if the completion belonged to the ring, FALSE if it belongs to
+ * a process waiting in SYS5.
+ */
+int termRxInterrupt(int termNum, unsigned int statusCode) {
+  rxring_t *ring = &rxRing[termNum];
+
+  if (!ring->rx_armed) {
+    return FALSE;
+  }
+  ring->rx_armed = FALSE;
+
+  if ((statusCode & TERMINT_STATUS_MASK) == CHAR_RECEIVED) {
+    char c = (statusCode >> BYTELEN) & TERMINT_STATUS_MASK;
+    int tail = (ring->rx_head + ring->rx_count) % TERM_RXBUF_SIZE;
+    ring->rx_buf[tail] = c;
+    ring->rx_count++;
+    if (c == '\n') {
+      ring->rx_lines++;
+    }
+  } else {
+    ring->rx_error = statusCode;
+  }
+
+  armReceiver(termNum, ring);
+
+  if (ring->rx_lines > 0 || ring->rx_count == TERM_RXBUF_SIZE ||
+      ring->rx_error != 0) {
+    wakeAll(&termRxSem[termNum]);
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Check whether a terminal transmitter is busy with buffered output.
+ *
+ * @param termNum Terminal number (0-7).
+ * @return TRUE if the transmit ring currently drives the device.
+ */
+int termTxBusy(int termNum) { return txRing[termNum].tx_busy; }
+
+/**
+ * @brief Check whether all buffered output of a terminal has been sent.
+ *
+ * @param termNum Terminal number (0-7).
+ * @return TRUE if the transmit ring is empty.
+ */
+int termTxEmpty(int termNum) { return txRing[termNum].tx_count == 0; }
+
+/**
+ * @brief Start a string transfer to a printer or terminal transmitter.
+ *
+ * Issues the first character. The caller must then wait on the device
+ * semaphore as for SYS5: it is signalled with the final device status once the
+ * whole string has been sent or a character failed.
+ *
+ * @param devIdx Device index of a printer or terminal transmitter.
+ * @param buf Kernel buffer holding the string; it must stay valid until the
+ * transfer completes.
+ * @param len Number of characters to send (at least 1).
+ */
+void xferStart(int devIdx, char *buf, int len) {
+  xfer_t *xfer = &xfers[XFER_IDX(devIdx)];
+  xfer->x_buf = buf;
+  xfer->x_len = len;
+  xfer->x_pos = 0;
+  xfer->x_active = TRUE;
+  transmitXferChar(devIdx, xfer);
+}
+
+/**
+ * @brief Advance a string transfer after a character completion.
+ *
+ * Called by the device interrupt handler once the interrupt has been
+ * acknowledged. If the character was sent and more remain, the next one is
+ * issued and the completion is consumed. Otherwise the transfer ends and the
+ * completion is passed on, so that the waiting caller is woken with the
+ * status. On a terminal, output buffered in the meantime is then resumed.
+ *
+ * @param devIdx Device index of a printer or terminal transmitter.
+ * @param statusCode The device status read before the acknowledgement.
+ * @return TRUE if the completion was consumed by the transfer, FALSE if it
+ * must be delivered through the device semaphore.
+ */
+int xferInterrupt(int devIdx, unsigned int statusCode) {
+  xfer_t *xfer = &xfers[XFER_IDX(devIdx)];
+
+  if (!xfer->x_active) {
+    return FALSE;
+  }
+
+  int isTerminal = devIdx >= (TERMINT - DISKINT) * DEVPERINT;
+  int sent = isTerminal
+                 ? (statusCode & TERMINT_STATUS_MASK) == CHAR_TRANSMITTED
+                 : statusCode == READY;
+
+  if (sent && xfer->x_pos + 1 < xfer->x_len) {
+    xfer->x_pos++;
+    transmitXferChar(devIdx, xfer);
+    return TRUE;
+  }
+
+  /* Whole string sent, or a character failed: the transfer is over */
+  xfer->x_active = FALSE;
+  if (isTerminal) {
+    int termNum = devIdx - (TERMINT - DISKINT) * DEVPERINT;
+    txring_t *ring = &txRing[termNum];
+    if (ring->tx_count > 0) {
+      ring->tx_busy = TRUE;
+      transmitHead(termNum, ring);
+    }
+  }
+  return FALSE;
+}
@@ -4,7 +4,8 @@
  * @brief This module implements the Exception Handling routines for Phase 2. It
  * handles system call exceptions, program trap exceptions, TLB exceptions, and
  * device interrupts. The module defines handlers for various system call
- * services (SYS1 through SYS8), as well as helper functions for process
+ * services (SYS1 through SYS8) and the extended Nucleus services, as well as
+ * helper functions for process
  * termination, state copying, process blocking on a semaphore, and exception
  * pass-up.
  * @date 2025-04-17
@@ -16,10 +17,15 @@
 #include "../h/exceptions.h"
 
 #include "../h/asl.h"
+#include "../h/charIO.h"
 #include "../h/initial.h"
 #include "../h/interrupts.h"
 #include "../h/pcb.h"
+#include "../h/quota.h"
 #include "../h/scheduler.h"
+#include "../h/smp.h"
+#include "../h/timers.h"
+#include "../h/waitAny.h"
 #include "umps3/umps/libumps.h"
 
 /**
@@ -46,41 +52,86 @@ void copyState(state_t *dest, state_t *src) {
 }
 
 /**
- * @brief SYS1: Create a new child process.
+ * @brief Create a new process and insert it into a ready queue.
  *
- * Allocates a new PCB, initializes its state from the given pointer (in s_a1),
- * sets its support structure pointer from s_a2, and inserts it into the ready
- * queue. Sets s_v0 to 0 on success or -1 if no free PCBs are available.
- *
- * @param savedExcState The saved exception state of the calling process.
+ * @param statep Initial processor state of the process.
+ * @param supportp Its support structure, or NULL.
+ * @param sibling TRUE to make it a child of the caller's parent, FALSE to
+ * make it a child of the caller.
+ * @param quota Its CPU quota, or NULL for none (a sibling gets the caller's).
+ * @return OK, or ERR if no free PCBs are available.
  */
-HIDDEN void sysCreateProc(state_t *savedExcState) {
+HIDDEN int createProc(state_t *statep, support_t *supportp, int sibling,
+                      quota_t *quota) {
   pcb_PTR p = allocPcb();
-
   if (p == NULL) {
     /* No more free pcb's */
-    savedExcState->s_v0 = ERR;
+    return ERR;
+  }
+
+  /* Initialize all fields of the new process */
+  copyState(&p->p_s, statep);
+  p->p_time = 0;
+  p->p_userTime = 0;
+  p->p_kernelTime = 0;
+  p->p_semAdd = NULL;
+  p->p_supportStruct = supportp;
+  if (quota == NULL && sibling) {
+    /* Part of the caller's job (a forked U-proc or a thread) */
+    quota = &currentProc->p_quota;
+  }
+  if (quota != NULL) {
+    quotaSet(p, quota);
+  }
+
+  /* Make this process alive */
+  makeReady(p);
+  if (sibling && currentProc->p_prnt != NULL) {
+    insertChild(currentProc->p_prnt, p);
   } else {
-    /* Successfully create a new process */
-    state_t *statep = (state_t *)savedExcState->s_a1;
-    support_t *supportp = (support_t *)savedExcState->s_a2;
-
-    /* Initialize all fields of the new process */
-    copyState(&p->p_s, statep);
-    p->p_time = 0;
-    p->p_semAdd = NULL;
-    p->p_supportStruct = supportp;
-
-    /* Make this process alive */
-    insertProcQ(&readyQueue, p);
     insertChild(currentProc, p);
-    procCnt++;
-    savedExcState->s_v0 = OK;
   }
+  procCnt++;
+  return OK;
+}
 
+/**
+ * @brief SYS1: Create a new child process.
+ *
+ * Allocates a new PCB, initializes its state from the given pointer (in s_a1),
+ * sets its support structure pointer from s_a2, and inserts it into the ready
+ * queue. Sets s_v0 to 0 on success or -1 if no free PCBs are available.
+ *
+ * If s_a3 is CREATE_SIBLING, the new process becomes a child of the caller's
+ * parent instead, so that it outlives the caller's termination, and gets the
+ * caller's CPU quota (SYS47).
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ */
+HIDDEN void sysCreateProc(state_t *savedExcState) {
+  savedExcState->s_v0 = createProc(
+      (state_t *)savedExcState->s_a1, (support_t *)savedExcState->s_a2,
+      savedExcState->s_a3 == CREATE_SIBLING, NULL);
   switchContext(savedExcState);
 }
 
+/**
+ * @brief Check whether a semaphore is a Nucleus-maintained semaphore that
+ * processes wait on for I/O or time (device semaphores, the pseudo-clock, the
+ * character I/O semaphores, the SYS44 timer semaphore and the SYS46 wait-any
+ * semaphore).
+ *
+ * Processes blocked on such semaphores are counted in softBlockCnt, and their
+ * value is adjusted by the interrupt handlers rather than by SYS4.
+ *
+ * @param sem Pointer to the semaphore.
+ * @return TRUE if processes blocked on sem are soft-blocked.
+ */
+HIDDEN int isSoftBlockSem(int *sem) {
+  return (sem >= deviceSem && sem <= &deviceSem[PSEUDOCLOCK]) ||
+         isCharIOSem(sem) || isTimerSem(sem) || isWaitAnySem(sem);
+}
+
 /**
  * @brief Recursively terminate a process and all its descendants.
  *
@@ -108,17 +159,30 @@ HIDDEN void terminateProcHelper(pcb_PTR p) {
   } else if (p->p_semAdd != NULL) {
     /* p is blocked on the ASL */
     int *sem = p->p_semAdd;
+    int timed = p->p_timed;
     outBlocked(p);
-    if (sem >= deviceSem && sem < deviceSem + NUMDEVICES) {
+    timerCancel(p); /* Forget its deadline as well, if any */
+    if (isWaitAnySem(sem)) {
+      /* Stop watching its devices */
+      waitAnyCancel(p);
+    }
+    if (isSoftBlockSem(sem)) {
       /* Device semaphore will be adjusted in device interrupt handler */
       softBlockCnt--;
     } else {
       /* Adjust non-device semaphore */
       (*sem)++;
+      if (timed) {
+        /* A timed P is soft-blocked as well */
+        softBlockCnt--;
+      }
     }
-  } else {
-    /* p is on the ready queue */
-    outProcQ(&readyQueue, p);
+  } else if (outReady(p) == NULL) {
+    /* p runs on another processor, or is on its way to processor 0: it is
+     * freed by processor 0 once handed over (see scheduler()) */
+    p->p_killed = TRUE;
+    procCnt--;
+    return;
   }
 
   /* Clean up the process */
@@ -158,10 +222,9 @@ HIDDEN void waitOnSem(int *sem, state_t *savedExcState) {
   /* Save the exception state */
   copyState(&currentProc->p_s, savedExcState);
   /* Update the accumulated CPU time for the Current Process */
-  cpu_t now;
-  STCK(now);
-  currentProc->p_time += now - quantumStartTime;
+  chargeCPU(currentProc, FALSE);
   /* Block the current process and find another process to run */
+  blockProc(currentProc);
   insertBlocked(sem, currentProc);
   currentProc = NULL;
   scheduler();
@@ -205,7 +268,12 @@ HIDDEN void sysVerhogen(state_t *savedExcState) {
     /* Unblock one process waiting on this semaphore, if any */
     pcb_PTR p = removeBlocked(sem);
     if (p != NULL) {
-      insertProcQ(&readyQueue, p);
+      if (p->p_timed) {
+        /* A timed P (SYS45) won the race against its timeout */
+        timerCancel(p);
+        softBlockCnt--;
+      }
+      wakeProc(p);
     }
   }
 
@@ -246,8 +314,10 @@ HIDDEN void sysWaitIO(state_t *savedExcState) {
 /**
  * @brief SYS6: Return total CPU time used by the current process.
  *
- * Computes the sum of the process's accumulated CPU time (p_time) and the
- * elapsed time in the current quantum. The result is returned in s_v0.
+ * Computes the sum of the process's accumulated CPU time (p_time, its user and
+ * kernel time) and the time not yet charged to it. Device and Interval Timer
+ * interrupts that occurred while it ran are not included. The result is
+ * returned in s_v0.
  *
  * @param savedExcState The saved exception state of the calling process.
  * @return This function does not return; control is transferred via
@@ -256,11 +326,65 @@ HIDDEN void sysWaitIO(state_t *savedExcState) {
 HIDDEN void sysGetCPUTime(state_t *savedExcState) {
   cpu_t now;
   STCK(now);
-  cpu_t elapsed = now - quantumStartTime;
+  cpu_t elapsed = now - chargeStartTime;
   savedExcState->s_v0 = currentProc->p_time + elapsed;
   switchContext(savedExcState);
 }
 
+/**
+ * @brief SYS48: Return the CPU time the current process used in user mode.
+ *
+ * Its user time is charged up to this call. Device and Interval Timer
+ * interrupts that occurred while it ran are not included. The result is
+ * returned in s_v0.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext.
+ */
+HIDDEN void sysGetUserTime(state_t *savedExcState) {
+  savedExcState->s_v0 = currentProc->p_userTime;
+  switchContext(savedExcState);
+}
+
+/**
+ * @brief SYS49: Return the CPU time the current process used in kernel mode,
+ * including the Nucleus services it asked for, up to now.
+ *
+ * Device and Interval Timer interrupts that occurred while it ran are not
+ * included. The result is returned in s_v0.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext.
+ */
+HIDDEN void sysGetKernelTime(state_t *savedExcState) {
+  cpu_t now;
+  STCK(now);
+  cpu_t elapsed = now - chargeStartTime; /* This call so far */
+  savedExcState->s_v0 = currentProc->p_kernelTime + elapsed;
+  switchContext(savedExcState);
+}
+
+/**
+ * @brief SYS50: Return the time all processors spent handling device and
+ * Interval Timer interrupts since boot, charged to no process. The result is
+ * returned in s_v0.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext.
+ */
+HIDDEN void sysGetInterruptTime(state_t *savedExcState) {
+  cpu_t total = 0;
+  int cpu;
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    total += interruptTimes[cpu];
+  }
+  savedExcState->s_v0 = total;
+  switchContext(savedExcState);
+}
+
 /**
  * @brief SYS7: Wait on the pseudo-clock semaphore.
  *
@@ -316,6 +440,267 @@ HIDDEN void passUpOrDie(state_t *savedExcState, int exceptType) {
   }
 }
 
+/**
+ * @brief SYS41: Buffer characters for a terminal transmitter.
+ *
+ * Copies up to s_a3 characters from the kernel buffer in s_a2 into the
+ * transmit ring of terminal s_a1 and returns the number accepted in s_v0 (or
+ * the negated status of an earlier failed transmission). The interrupt handler
+ * transmits the buffered characters, so the caller does not wait for them. If
+ * the ring is full, the caller is blocked until the ring drains and the
+ * syscall is then re-issued. With s_a3 == 0 the caller instead waits until
+ * everything buffered so far has been transmitted.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext or waitOnSem.
+ */
+HIDDEN void sysWriteTermBuf(state_t *savedExcState) {
+  int termNum = savedExcState->s_a1;
+  char *src = (char *)savedExcState->s_a2;
+  int len = savedExcState->s_a3;
+
+  if (termNum < 0 || termNum >= DEVPERINT || len < 0) {
+    savedExcState->s_v0 = ERR;
+    switchContext(savedExcState);
+  }
+
+  int n = termTxPut(termNum, src, len);
+  if (n == 0 && (len > 0 || !termTxEmpty(termNum))) {
+    /* Ring is full (or not yet empty for a drain): wait for it to drain,
+     * then restart the SYSCALL */
+    savedExcState->s_pc -= WORDLEN;
+    termTxSem[termNum]--;
+    softBlockCnt++;
+    waitOnSem(&termTxSem[termNum], savedExcState);
+  }
+
+  savedExcState->s_v0 = n;
+  switchContext(savedExcState);
+}
+
+/**
+ * @brief SYS42: Take input from a terminal's read-ahead buffer.
+ *
+ * Copies the oldest buffered line of terminal s_a1 (including its newline)
+ * into the kernel buffer in s_a2, which must hold TERM_RXBUF_SIZE characters,
+ * and returns its length in s_v0 (or the negated status of a failed receipt).
+ * If no complete line is buffered, a blocking caller (s_a3 == FALSE) waits for
+ * one and the syscall is then re-issued, while a non-blocking caller gets
+ * whatever has been received so far, possibly nothing.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext or waitOnSem.
+ */
+HIDDEN void sysReadTermBuf(state_t *savedExcState) {
+  int termNum = savedExcState->s_a1;
+  char *dst = (char *)savedExcState->s_a2;
+  int nonBlocking = savedExcState->s_a3;
+
+  if (termNum < 0 || termNum >= DEVPERINT) {
+    savedExcState->s_v0 = ERR;
+    switchContext(savedExcState);
+  }
+
+  if (!termRxLineReady(termNum) && !nonBlocking) {
+    /* Wait for a complete line, then restart the SYSCALL */
+    savedExcState->s_pc -= WORDLEN;
+    termRxSem[termNum]--;
+    softBlockCnt++;
+    waitOnSem(&termRxSem[termNum], savedExcState);
+  }
+
+  savedExcState->s_v0 = termRxGet(termNum, dst);
+  switchContext(savedExcState);
+}
+
+/**
+ * @brief SYS43: Send a whole string to a printer or terminal transmitter.
+ *
+ * s_a1 holds the device index of the printer (24-31) or terminal transmitter
+ * (32-39), s_a2 a kernel buffer and s_a3 the string length. The first
+ * character is issued here and the caller is blocked as for SYS5; the
+ * interrupt handler issues the remaining characters itself and wakes the
+ * caller once, with the status of the last character in s_v0. If the terminal
+ * is busy with buffered output, the caller waits for it to drain and the
+ * syscall is then re-issued.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext or waitOnSem.
+ */
+HIDDEN void sysXferString(state_t *savedExcState) {
+  int devIdx = savedExcState->s_a1;
+  char *buf = (char *)savedExcState->s_a2;
+  int len = savedExcState->s_a3;
+  int firstTerm = (TERMINT - DISKINT) * DEVPERINT;
+
+  if (devIdx < (PRNTINT - DISKINT) * DEVPERINT ||
+      devIdx >= firstTerm + DEVPERINT || len < 0) {
+    savedExcState->s_v0 = ERR;
+    switchContext(savedExcState);
+  }
+
+  if (len == 0) {
+    /* Nothing to send: report the device's success status */
+    savedExcState->s_v0 = (devIdx >= firstTerm) ? CHAR_TRANSMITTED : READY;
+    switchContext(savedExcState);
+  }
+
+  if (devIdx >= firstTerm && termTxBusy(devIdx - firstTerm)) {
+    /* Wait for the buffered output to drain, then restart the SYSCALL */
+    savedExcState->s_pc -= WORDLEN;
+    termTxSem[devIdx - firstTerm]--;
+    softBlockCnt++;
+    waitOnSem(&termTxSem[devIdx - firstTerm], savedExcState);
+  }
+
+  xferStart(devIdx, buf, len);
+
+  int *sem = &deviceSem[devIdx];
+  (*sem)--;
+  softBlockCnt++;                /* Process now waiting for I/O */
+  waitOnSem(sem, savedExcState); /* Always block */
+}
+
+/**
+ * @brief SYS44: Sleep until a deadline.
+ *
+ * s_a1 holds the TOD (microseconds since boot) at which the caller must be
+ * woken. A deadline that has already passed returns at once; otherwise the
+ * caller is soft-blocked and the timer module wakes it at the deadline, not
+ * at the next pseudo-clock tick.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext or waitOnSem.
+ */
+HIDDEN void sysWaitUntil(state_t *savedExcState) {
+  cpu_t deadline = savedExcState->s_a1;
+  cpu_t now;
+  STCK(now);
+
+  if (deadline <= now) {
+    switchContext(savedExcState);
+  }
+
+  timerInsert(currentProc, deadline);
+  softBlockCnt++;                     /* Process now waiting for time */
+  waitOnSem(&timerSem, savedExcState); /* Always block */
+}
+
+/**
+ * @brief SYS45: Perform a P operation with a timeout.
+ *
+ * s_a1 holds the semaphore and s_a2 the timeout in microseconds. If the P
+ * would block, the caller is blocked on the semaphore in the ASL and in the
+ * timer heap at the same time, and is soft-blocked until one of them wins:
+ * - A V unblocks it as for SYS3 and s_v0 is SEM_ACQUIRED.
+ * - If the timeout expires first, the timer module removes it from the ASL,
+ *   gives the semaphore back the unit the P took, and s_v0 is SEM_TIMEOUT.
+ * A timeout of 0 or less makes the call a non-blocking P.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext or waitOnSem.
+ */
+HIDDEN void sysPasserenTimed(state_t *savedExcState) {
+  int *sem = (int *)savedExcState->s_a1;
+  cpu_t timeout = savedExcState->s_a2;
+
+  savedExcState->s_v0 = SEM_ACQUIRED;
+  (*sem)--;
+  if (*sem >= 0) {
+    switchContext(savedExcState);
+  }
+
+  if (timeout <= 0) {
+    /* Would block: undo the P */
+    (*sem)++;
+    savedExcState->s_v0 = SEM_TIMEOUT;
+    switchContext(savedExcState);
+  }
+
+  cpu_t now;
+  STCK(now);
+  timerInsert(currentProc, now + timeout);
+  softBlockCnt++;                /* Process now waiting for time */
+  waitOnSem(sem, savedExcState); /* Always block */
+}
+
+/**
+ * @brief SYS46: Wait for the first of several devices to complete.
+ *
+ * s_a1 holds a kernel array of ioWait_t entries, each naming a device as the
+ * arguments of SYS5 do, and s_a2 the number of entries (1 to WAITANY_MAX).
+ * The caller performs the P of a SYS5 on every device and blocks once. The
+ * first device to complete wakes it with the index of its entry in s_v0 and
+ * the device status in s_v1; the P on every other device is undone. If an
+ * entry is invalid, s_v0 is ERR and the caller does not block.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ * @return This function does not return; control is transferred via
+ * switchContext or waitOnSem.
+ */
+HIDDEN void sysWaitIOAny(state_t *savedExcState) {
+  ioWait_t *waits = (ioWait_t *)savedExcState->s_a1;
+  int count = savedExcState->s_a2;
+
+  if (count < 1 || count > WAITANY_MAX) {
+    savedExcState->s_v0 = ERR;
+    switchContext(savedExcState);
+  }
+
+  int i;
+  for (i = 0; i < count; i++) {
+    int lineNum = waits[i].w_line;
+    int devNum = waits[i].w_dev;
+    int isRead = waits[i].w_read;
+    if (lineNum < DISKINT || lineNum > TERMINT || devNum < 0 ||
+        devNum >= DEVPERINT || (isRead && lineNum != TERMINT)) {
+      savedExcState->s_v0 = ERR;
+      switchContext(savedExcState);
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    /* Same semaphore index as SYS5 */
+    int semIdx = (waits[i].w_line - DISKINT + (waits[i].w_read ? 1 : 0)) *
+                     DEVPERINT +
+                 waits[i].w_dev;
+    if (!waitAnyAdd(currentProc, semIdx, i)) {
+      /* Out of watch entries: give back the ones taken */
+      waitAnyCancel(currentProc);
+      savedExcState->s_v0 = ERR;
+      switchContext(savedExcState);
+    }
+  }
+
+  softBlockCnt++; /* Process now waiting for I/O */
+  waitOnSem(&waitAnySem, savedExcState); /* Always block */
+}
+
+/**
+ * @brief SYS47: Create a new child process with a CPU time quota.
+ *
+ * s_a1 and s_a2 are as for SYS1, and s_a3 holds a kernel quota_t:
+ * - q_limit: total CPU time after which the process is stopped as if it raised
+ *   a Program Trap (passed up to its Support Level, or terminated).
+ * - q_budget, q_period: CPU time it may use in each period of q_period; once
+ *   it is used up, the process sleeps until the next period.
+ * A field of 0 disables that part of the quota. Sets s_v0 to OK, or ERR if no
+ * free PCBs are available.
+ *
+ * @param savedExcState The saved exception state of the calling process.
+ */
+HIDDEN void sysCreateQuota(state_t *savedExcState) {
+  savedExcState->s_v0 = createProc(
+      (state_t *)savedExcState->s_a1, (support_t *)savedExcState->s_a2, FALSE,
+      (quota_t *)savedExcState->s_a3);
+  switchContext(savedExcState);
+}
+
 /* Define the function pointer type for syscalls */
 typedef void (*syscall_t)(state_t *);
 
@@ -335,13 +720,32 @@ HIDDEN syscall_t syscalls[] = {
     sysGetSupportData /* SYS 8 */
 };
 
+/*
+ * The extended syscall table maps syscall numbers starting at NUCLEUS_EXT_BASE
+ * to the corresponding service handler functions.
+ */
+HIDDEN syscall_t extSyscalls[] = {
+    sysWriteTermBuf,    /* SYS 41 */
+    sysReadTermBuf,     /* SYS 42 */
+    sysXferString,      /* SYS 43 */
+    sysWaitUntil,       /* SYS 44 */
+    sysPasserenTimed,   /* SYS 45 */
+    sysWaitIOAny,       /* SYS 46 */
+    sysCreateQuota,     /* SYS 47 */
+    sysGetUserTime,     /* SYS 48 */
+    sysGetKernelTime,   /* SYS 49 */
+    sysGetInterruptTime /* SYS 50 */
+};
+
+#define NUM_EXT_SYSCALLS (sizeof(extSyscalls) / sizeof(syscall_t))
+
 /**
  * @brief Handle system calls invoked via syscall exception.
  *
- * If the syscall number in s_a0 is between 1 and 8 and the process is in kernel
- * mode, the corresponding service is invoked. If the process is in user mode,
- * or the syscall number is invalid, the syscall is treated as a program trap
- * and passed up or terminates.
+ * If the syscall number in s_a0 is a Nucleus service (1-8 or an extended
+ * service) and the process is in kernel mode, the corresponding service is
+ * invoked. If the process is in user mode, the syscall is treated as a program
+ * trap. Any other syscall number is passed up or terminates the process.
  *
  * @param savedExcState The saved exception state of the calling process.
  * @return This function does not return; control is transferred via syscall or
@@ -349,8 +753,10 @@ HIDDEN syscall_t syscalls[] = {
  */
 HIDDEN void syscallHandler(state_t *savedExcState) {
   int num = savedExcState->s_a0;
+  int isExt = num >= NUCLEUS_EXT_BASE &&
+              num < NUCLEUS_EXT_BASE + (int)NUM_EXT_SYSCALLS;
 
-  if (num >= 1 && num <= 8) {
+  if ((num >= 1 && num <= 8) || isExt) {
     if (savedExcState->s_status & STATUS_KUP) {
       /* If previous mode was user mode (KUP = 1), simulate a program trap */
       savedExcState->s_cause =
@@ -360,13 +766,52 @@ HIDDEN void syscallHandler(state_t *savedExcState) {
       /* If previous mode was kernel mode (KUP = 0), handle the syscall */
       savedExcState->s_pc += WORDLEN; /* control of the current process should
                                          be returned to the next instruction */
-      syscalls[num](savedExcState);
+      if (isExt) {
+        extSyscalls[num - NUCLEUS_EXT_BASE](savedExcState);
+      } else {
+        syscalls[num](savedExcState);
+      }
     }
   } else {
     passUpOrDie(savedExcState, GENERALEXCEPT);
   }
 }
 
+/**
+ * @brief Stop the current process, which reached its CPU time limit: pass a
+ * Program Trap up to its Support Level, which terminates it, or terminate it.
+ *
+ * @param savedExcState The state of the current process.
+ * @return This function does not return.
+ */
+void stopOverLimit(state_t *savedExcState) {
+  /* The state may come from an interrupt: mark it as a Program Trap */
+  savedExcState->s_cause =
+      (savedExcState->s_cause & ~EXCCODE_MASK) | RI_EXCCODE;
+  passUpOrDie(savedExcState, GENERALEXCEPT);
+}
+
+/**
+ * @brief Hand the current process over to processor 0, with the exception it
+ * raised on this processor.
+ *
+ * Saves the exception state in the pcb, updates the process's CPU time and
+ * queues it for processor 0, which handles the exception as if it was raised
+ * there.
+ *
+ * @param savedExcState The saved exception state of the current process.
+ * @return This function does not return; control is transferred to the
+ * scheduler.
+ */
+HIDDEN void forwardException(state_t *savedExcState) {
+  copyState(&currentProc->p_s, savedExcState);
+  chargeCPU(currentProc, FALSE);
+  currentProc->p_forward = TRUE;
+  makeReady(currentProc);
+  currentProc = NULL;
+  scheduler();
+}
+
 /**
  * @brief Top-level handler for all exceptions.
  *
@@ -377,13 +822,32 @@ HIDDEN void syscallHandler(state_t *savedExcState) {
  * - syscallHandler for syscall exceptions
  * Calls PANIC() for unknown exception codes.
  *
+ * The current process is first charged with the CPU time it used in the mode
+ * it ran in. Only processor 0 runs Nucleus services: another processor handles the PLT
+ * itself but hands any other exception, and a process killed while it ran
+ * there, over to processor 0, which handles the exception when it dispatches
+ * the process.
+ *
  * @return This function does not return; control is transferred to appropriate
  * handlers.
  */
 void generalExceptionHandler() {
-  state_t *savedExcState = (state_t *)BIOSDATAPAGE;
+  state_t *savedExcState = CPU_STATE(getPRID());
   unsigned int excCode = CAUSE_EXCCODE(savedExcState->s_cause);
 
+  /* Charge the current process for the mode it ran in until now */
+  if (currentProc != NULL) {
+    chargeCPU(currentProc, savedExcState->s_status & STATUS_KUP);
+  } else {
+    STCK(chargeStartTime);
+  }
+
+  tlbSync();
+  if (getPRID() != CPU0 && currentProc != NULL &&
+      (excCode != 0 || currentProc->p_killed)) {
+    forwardException(savedExcState);
+  }
+
   if (excCode == 0) {
     /* Interrupt exception */
     interruptHandler(savedExcState);
@@ -6,11 +6,13 @@
  * 1. Defining relevant global variables for Nucleus.
  * 2. Populating the Processor 0 Pass Up Vector with the appropriate handler
  * addresses and stack pointers.
- * 3. Initializing the PCB free list and the Active Semaphore List (ASL).
+ * 3. Initializing the PCB free list, the Active Semaphore List (ASL) and the
+ * character I/O buffers.
  * 4. Setting up Nucleus maintained global variables.
  * 5. Loading the system-wide Interval Timer with a 100-millisecond tick.
  * 6. Instantiating an initial test process with the proper processor state.
- * 7. Calling the scheduler to dispatch processes.
+ * 7. Starting the other processors, if any, and calling the scheduler to
+ * dispatch processes.
  * @date 2025-04-17
  *
  * @copyright Copyright (c) 2025
@@ -20,9 +22,13 @@
 #include "../h/initial.h"
 
 #include "../h/asl.h"
+#include "../h/charIO.h"
 #include "../h/exceptions.h"
 #include "../h/pcb.h"
 #include "../h/scheduler.h"
+#include "../h/smp.h"
+#include "../h/timers.h"
+#include "../h/waitAny.h"
 
 /* Test function of phase 2 */
 extern void test();
@@ -36,9 +42,9 @@ int procCnt;      /* The number of started, but not yet terminated processes */
 int softBlockCnt; /* The number of started, but not terminated processes that
                    * are in the "block" state due to an I/O or time request
                    */
-pcb_PTR readyQueue;  /* Tail pointer to a queue of pcbs that are in the "ready"
-                        state */
-pcb_PTR currentProc; /* Pointer to the pcb that is in the "running" state */
+pcb_PTR volatile currentProcs[NUM_CPUS]; /* Per processor, pointer to the pcb
+                                          * that is in the "running" state; read
+                                          * by the other processors */
 int deviceSem[NUMDEVICES +
               1]; /* One additional semaphore to support the Pseudo-clock */
 
@@ -49,11 +55,12 @@ int deviceSem[NUMDEVICES +
  * - Sets TLB and exception handlers in the Pass Up Vector.
  * - Initializes the PCB free list and Active Semaphore List (ASL).
  * - Resets global variables: process count, soft-block count, ready-process
- * queue, current process pointer, device semaphore.
+ * queues, current process pointers, device semaphore.
  * - Loads the interval timer with a 100ms tick.
  * - Creates an initial process with kernel-mode state, stack pointer set to
  * RAMTOP, and entry point set to `init()`.
- * - Calls the scheduler to begin process execution.
+ * - Starts the other processors and calls the scheduler to begin process
+ * execution.
  *
  * @return This function does not return; control passes to the scheduler.
  */
@@ -68,23 +75,26 @@ void main() {
   /* 3. Initialize pcb free list, active semaphore list, active delay list */
   initPcbs();
   initASL();
+  initCharIO();
+  initWaitAny();
 
   /* 4. Initialize all Nuclueus maintained variables */
   procCnt = 0;
   softBlockCnt = 0;
-  readyQueue = mkEmptyProcQ();
-  currentProc = NULL;
+  initReadyQueues();
   int i;
+  for (i = 0; i < NUM_CPUS; i++) {
+    currentProcs[i] = NULL;
+  }
   for (i = 0; i < NUMDEVICES + 1; i++) {
     deviceSem[i] = 0;
   }
 
   /* 5. Load the system-wide Interval Timer with 100 milliseconds */
-  LDIT(SYSTEM_TICK_INTERVAL);
+  initTimers();
 
   /* 6. Instantiate a single process */
   pcb_PTR p = allocPcb();
-  insertProcQ(&readyQueue, p);
   procCnt++;
 
   /* Note: When setting up a new processor state, one must set the previous bits
@@ -103,7 +113,9 @@ void main() {
   p->p_s.s_pc = (memaddr)init;
   p->p_s.s_t9 = (memaddr)init; /* This register must get the same value as
                                  PC whenever PC is assigned a new value */
+  makeReady(p);
 
-  /* 7. Call the scheduler */
+  /* 7. Start the other processors and call the scheduler */
+  startCPUs();
   scheduler();
 }
@@ -6,7 +6,7 @@
  * - Handling Processor Local Timer (PLT) interrupts to preempt the running
  * process.
  * - Handling Interval Timer interrupts to unblock processes waiting on the
- * pseudo-clock.
+ * pseudo-clock or sleeping until a deadline.
  * - Handling device interrupts (including terminal devices) by acknowledging
  * the interrupt, performing the corresponding V operation on the appropriate
  * semaphore, and unblocking any waiting process. The module uses helper
@@ -21,19 +21,58 @@
 #include "../h/interrupts.h"
 
 #include "../h/asl.h"
+#include "../h/charIO.h"
 #include "../h/exceptions.h"
 #include "../h/initial.h"
 #include "../h/pcb.h"
+#include "../h/quota.h"
 #include "../h/scheduler.h"
+#include "../h/timers.h"
+#include "../h/waitAny.h"
 #include "umps3/umps/libumps.h"
 
+/* Per processor, time (in microseconds) spent handling device and Interval
+ * Timer interrupts since boot. It is charged to no process. Each processor
+ * only updates its own entry */
+cpu_t interruptTimes[NUM_CPUS];
+
+/**
+ * @brief Finish handling a device or Interval Timer interrupt.
+ *
+ * The time since the Nucleus was entered is added to the interrupt time rather
+ * than charged to the interrupted process. Returns control to the current
+ * process, or invokes the scheduler if the processor was waiting.
+ *
+ * @param savedExcState The saved exception state at the time of the interrupt.
+ * @return This function does not return; control is transferred via
+ * switchContext or scheduler.
+ */
+HIDDEN void endInterrupt(state_t *savedExcState) {
+  cpu_t now;
+  STCK(now);
+  interruptTimes[getPRID()] += now - chargeStartTime;
+  chargeStartTime = now;
+
+  if (currentProc == NULL) {
+    /* Wake up from WAIT state */
+    scheduler();
+  } else {
+    /* Return control to the current process */
+    switchContext(savedExcState);
+  }
+}
+
 /**
  * @brief Handle device interrupts (non-timer devices, including terminals).
  *
- * Acknowledges the device interrupt by issuing an ACK command. Performs a V
- * operation on the corresponding Nucleus-managed semaphore. If a process is
- * waiting on the device, it is unblocked, its return value (s_v0) is set to the
- * device status, and it is moved to the ready queue.
+ * Acknowledges the device interrupt by issuing an ACK command. Completions of a
+ * terminal sub-device whose I/O is buffered in the Nucleus, or of a printer or
+ * transmitter in the middle of a string transfer, are handed to the character
+ * I/O module, which issues the next command itself. Otherwise,
+ * performs a V operation on the corresponding Nucleus-managed semaphore. If a
+ * process is waiting on the device, it is unblocked, its return value (s_v0) is
+ * set to the device status, and it is moved to the ready queue. Otherwise the
+ * completion goes to a process waiting on several devices (SYS46), if any.
  *
  * @param savedExcState The saved exception state at the time of the interrupt.
  * @param lineNum Interrupt line number (3–7).
@@ -54,16 +93,20 @@ HIDDEN void handleDeviceInterrupt(state_t *savedExcState, int lineNum,
   unsigned int recvStatus = devreg->t_recv_status & TERMINT_STATUS_MASK;
 
   unsigned int statusCode;
+  int buffered = FALSE; /* TRUE if the Nucleus itself consumed the completion */
   if (lineNum == TERMINT) {
     if (transStatus != BUSY && transStatus != READY) {
       /* Transmitter (write) - higher priority */
       statusCode = devreg->t_transm_status;
       devreg->t_transm_command = ACK; /* Ack transmit */
       /* devIdx maps to write semaphores (32-39) directly */
+      buffered = termTxInterrupt(devNum, statusCode) ||
+                 xferInterrupt(devIdx, statusCode);
     } else if (recvStatus != BUSY && recvStatus != READY) {
       /* Receiver (read) */
       statusCode = devreg->t_recv_status;
       devreg->t_recv_command = ACK; /* Ack receive */
+      buffered = termRxInterrupt(devNum, statusCode);
       /* Offset devIdx by DEVPERINT (8) to map to read semaphores (40-47), since
          terminal devices have two sub-devices per devNum:
           - Write: 32-39 (base index from TERMINT - DISKINT = 4 * 8)
@@ -77,25 +120,27 @@ HIDDEN void handleDeviceInterrupt(state_t *savedExcState, int lineNum,
     /* Non-terminal devices */
     statusCode = devreg->d_status;
     devreg->d_command = ACK;
+    if (lineNum == PRNTINT) {
+      buffered = xferInterrupt(devIdx, statusCode);
+    }
     /* devIdx maps directly to semaphores 0-31 for lines 3-6 */
   }
 
-  /* Perform a V operation on the Nucleus maintained semaphore */
-  deviceSem[devIdx]++;
-  pcb_PTR p = removeBlocked(&deviceSem[devIdx]);
-  if (p != NULL) {
-    p->p_s.s_v0 = statusCode; /* Return status to process */
-    softBlockCnt--;
-    insertProcQ(&readyQueue, p);
+  if (!buffered) {
+    /* Perform a V operation on the Nucleus maintained semaphore */
+    deviceSem[devIdx]++;
+    pcb_PTR p = removeBlocked(&deviceSem[devIdx]);
+    if (p != NULL) {
+      p->p_s.s_v0 = statusCode; /* Return status to process */
+      softBlockCnt--;
+      wakeProc(p);
+    } else {
+      /* Nobody waits in SYS5: wake the oldest SYS46 caller on this device */
+      waitAnyInterrupt(devIdx, statusCode);
+    }
   }
 
-  if (currentProc == NULL) {
-    /* Wake up from WAIT state */
-    scheduler();
-  } else {
-    /* Return control to the current process */
-    switchContext(savedExcState);
-  }
+  endInterrupt(savedExcState);
 }
 
 /**
@@ -103,7 +148,8 @@ HIDDEN void handleDeviceInterrupt(state_t *savedExcState, int lineNum,
  *
  * Signals that the current process's quantum has expired. Reloads the timer for
  * a new quantum, updates the process's CPU time, saves its state, enqueues it
- * back on the ready queue, and invokes the scheduler.
+ * back on the ready queue, and invokes the scheduler. On an idle processor it
+ * only invokes the scheduler, to look for work to steal.
  *
  * @param savedExcState The saved exception state at the time of the PLT
  * interrupt.
@@ -112,17 +158,19 @@ HIDDEN void handleDeviceInterrupt(state_t *savedExcState, int lineNum,
 HIDDEN void handlePLT(state_t *savedExcState) {
   /* Acknowledge the interrupt by reloading the timer with a 5ms time slice */
   setTIMER(QUANTUM);
+  if (currentProc == NULL) {
+    scheduler();
+  }
 
   /* Copy the saved exception state into the current process's pcb */
   copyState(&currentProc->p_s, savedExcState);
 
   /* Update the accumulated CPU time */
-  cpu_t now;
-  STCK(now);
-  currentProc->p_time += now - quantumStartTime;
+  chargeCPU(currentProc, FALSE);
 
-  /* Enqueue the current process back into the ready queue */
-  insertProcQ(&readyQueue, currentProc);
+  /* Enqueue the current process back into the ready queue, where its CPU
+   * quota is enforced when it is dispatched again */
+  preemptProc(currentProc);
   currentProc = NULL;
 
   /* Call the scheduler */
@@ -130,44 +178,29 @@ HIDDEN void handlePLT(state_t *savedExcState) {
 }
 
 /**
- * @brief Handle Interval Timer interrupt (every 100ms).
+ * @brief Handle Interval Timer interrupt.
  *
- * Acknowledges the timer interrupt by reloading it. Unblocks all processes
- * waiting on the pseudo-clock semaphore and resets that semaphore to 0. Invokes
- * the scheduler if no process is currently running.
+ * The Interval Timer is shared by the 100ms pseudo-clock tick and the
+ * processes sleeping until a deadline (SYS44). The timer module unblocks the
+ * pseudo-clock waiters when a tick is due, wakes every sleeper whose deadline
+ * has passed and reloads the timer for the next event, which acknowledges the
+ * interrupt. Invokes the scheduler if no process is currently running.
  *
  * @param savedExcState The saved exception state at the time of the interrupt.
  * @return This function does not return; control is transferred via
  * switchContext or scheduler.
  */
 HIDDEN void handleIntervalTimer(state_t *savedExcState) {
-  /* Acknowledge the interrupt by reloading the interval timer with 100ms */
-  LDIT(SYSTEM_TICK_INTERVAL);
-
-  /* Unblock all processes waiting on the pseudo-clock semaphore */
-  int *pseudoSem = &deviceSem[PSEUDOCLOCK];
-  pcb_PTR p;
-  while ((p = removeBlocked(pseudoSem)) != NULL) {
-    insertProcQ(&readyQueue, p);
-    softBlockCnt--;
-  }
-
-  /* Reset pseudo-clock semaphore */
-  *pseudoSem = 0;
+  timerInterrupt();
 
-  if (currentProc == NULL) {
-    /* Wake up from WAIT state */
-    scheduler();
-  } else {
-    /* Return control to the current process */
-    switchContext(savedExcState);
-  }
+  endInterrupt(savedExcState);
 }
 
 /**
  * @brief Main interrupt dispatcher for all interrupt types.
  *
  * Determines which interrupt(s) are pending by examining the Cause register:
+ * - Line 0: an inter-processor interrupt (TLB shootdown) is acknowledged
  * - Line 1: PLT interrupt is handled by handlePLT()
  * - Line 2: Interval Timer is handled by handleIntervalTimer()
  * - Lines 3–7: Device interrupts are handled by handleDeviceInterrupt()
@@ -184,7 +217,11 @@ void interruptHandler(state_t *savedExcState) {
   devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
 
   /* Handle highest-priority interrupts first */
-  if (pendingInterrupts & STATUS_IM(1)) {
+  if (pendingInterrupts & STATUS_IM(IPIINT)) {
+    /* Inter-processor interrupt (line 0): the TLB shootdown it asks for was
+     * carried out on entry, so only acknowledge the message */
+    *((volatile unsigned int *)CPU_INBOX) = IPI_TLB_FLUSH;
+  } else if (pendingInterrupts & STATUS_IM(1)) {
     /* PLT interrupt (line 1) */
     handlePLT(savedExcState);
   } else if (pendingInterrupts & STATUS_IM(2)) {
@@ -209,9 +246,5 @@ void interruptHandler(state_t *savedExcState) {
     }
   }
 
-  if (currentProc == NULL) {
-    scheduler();
-  } else {
-    switchContext(savedExcState);
-  }
+  endInterrupt(savedExcState);
 }
@@ -0,0 +1,186 @@
+/**
+ * @file quota.c
+ * @author Dang Truong, Loc Pham
+ * @brief This module keeps the CPU time of processes and enforces the optional
+ * quotas set when they are created (SYS47).
+ *
+ * CPU time is split into user time (running in user mode) and kernel time
+ * (running in kernel mode, and Nucleus services on the process's behalf). A
+ * process is charged on every entry to the Nucleus, for the mode it ran in,
+ * and whenever the Nucleus stops serving it: when it blocks, is preempted or
+ * handed over, and when control returns to it. Device and Interval Timer
+ * interrupts are charged to nobody: the interrupt handler adds their time to
+ * the system-wide interrupt time instead (see interrupts.c).
+ *
+ * The quotas are:
+ * - A hard limit on the total CPU time. A process that reaches it is stopped
+ * as if it raised a Program Trap: it is passed up to its Support Level, which
+ * terminates it, or it is terminated.
+ * - A rate cap: a budget of CPU time per period. A process that used up its
+ * budget sleeps in the timer heap until the next period begins.
+ *
+ * Quotas are enforced by processor 0 when it dispatches the process, and only
+ * while the process is in user mode or has no Support Level, so that Support
+ * Level code is never stopped halfway. A time slice never runs past the
+ * remaining limit or budget.
+ * @date 2025-05-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/quota.h"
+
+#include "../h/asl.h"
+#include "../h/initial.h"
+#include "../h/scheduler.h"
+#include "../h/timers.h"
+#include "umps3/umps/libumps.h"
+
+/*====================Local function declarations====================*/
+
+HIDDEN int enforceable(pcb_PTR p);
+HIDDEN void rollPeriod(pcb_PTR p, cpu_t now);
+
+/*====================Global function definitions====================*/
+
+/**
+ * @brief Give a new process a CPU quota. Its first period begins now.
+ *
+ * @param p The process, not yet ready.
+ * @param quota The quota; negative fields count as 0 (no quota).
+ */
+void quotaSet(pcb_PTR p, quota_t *quota) {
+  p->p_quota.q_limit = quota->q_limit > 0 ? quota->q_limit : 0;
+  p->p_quota.q_budget = quota->q_budget > 0 ? quota->q_budget : 0;
+  p->p_quota.q_period = quota->q_period > 0 ? quota->q_period : 0;
+  if (p->p_quota.q_period == 0) {
+    /* A budget needs a period */
+    p->p_quota.q_budget = 0;
+  }
+  STCK(p->p_periodStart);
+  p->p_periodUsed = 0;
+}
+
+/**
+ * @brief Charge the current process of the calling processor with the CPU
+ * time it used since it was last charged.
+ *
+ * @param p The current process.
+ * @param user TRUE if it ran in user mode, FALSE if it ran in kernel mode or
+ * the Nucleus served it.
+ */
+void chargeCPU(pcb_PTR p, int user) {
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  cpu_t now;
+  STCK(now);
+  cpu_t used = now - chargeStartTime;
+  chargeStartTime = now;
+
+  p->p_time += used;
+  if (user) {
+    p->p_userTime += used;
+  } else {
+    p->p_kernelTime += used;
+  }
+  if (p->p_quota.q_budget > 0) {
+    rollPeriod(p, now);
+    p->p_periodUsed += used;
+  }
+  setSTATUS(status); /* Reenable interrupts */
+}
+
+/**
+ * @brief Check whether a process is to be stopped for reaching its CPU time
+ * limit.
+ *
+ * @param p The process.
+ * @return TRUE if so, FALSE otherwise.
+ */
+int overLimit(pcb_PTR p) {
+  return p->p_quota.q_limit > 0 && p->p_time >= p->p_quota.q_limit &&
+         enforceable(p);
+}
+
+/**
+ * @brief Check whether a process is to be throttled for using up its budget
+ * in the current period.
+ *
+ * @param p The process.
+ * @return TRUE if so, FALSE otherwise.
+ */
+int overBudget(pcb_PTR p) {
+  if (p->p_quota.q_budget == 0 || !enforceable(p)) {
+    return FALSE;
+  }
+  cpu_t now;
+  STCK(now);
+  rollPeriod(p, now);
+  return p->p_periodUsed >= p->p_quota.q_budget;
+}
+
+/**
+ * @brief Put a ready process over its budget to sleep until its next period.
+ * Called by processor 0.
+ *
+ * @param p The process, on no queue.
+ */
+void quotaThrottle(pcb_PTR p) {
+  timerInsert(p, p->p_periodStart + p->p_quota.q_period);
+  softBlockCnt++;
+  insertBlocked(&timerSem, p);
+}
+
+/**
+ * @brief Shorten a time slice so that it ends when the process reaches its
+ * CPU time limit or uses up its budget.
+ *
+ * @param p The process about to run.
+ * @param quantum The time slice the scheduling policy gives it.
+ * @return The time slice.
+ */
+unsigned int quotaSlice(pcb_PTR p, unsigned int quantum) {
+  cpu_t left;
+  if (p->p_quota.q_limit > 0) {
+    left = p->p_quota.q_limit - p->p_time;
+    if (left > 0 && (unsigned int)left < quantum) {
+      quantum = left;
+    }
+  }
+  if (p->p_quota.q_budget > 0) {
+    left = p->p_quota.q_budget - p->p_periodUsed;
+    if (left > 0 && (unsigned int)left < quantum) {
+      quantum = left;
+    }
+  }
+  return quantum;
+}
+
+/*====================Local function definitions====================*/
+
+/**
+ * @brief Check whether quotas may be enforced on a process now: it runs in
+ * user mode, or it has no Support Level.
+ *
+ * @param p The process.
+ * @return TRUE if so, FALSE otherwise.
+ */
+HIDDEN int enforceable(pcb_PTR p) {
+  return (p->p_s.s_status & STATUS_KUP) || p->p_supportStruct == NULL;
+}
+
+/**
+ * @brief Begin a new period of a rate-capped process if the current one is
+ * over, with a fresh budget.
+ *
+ * @param p The process.
+ * @param now The current TOD.
+ */
+HIDDEN void rollPeriod(pcb_PTR p, cpu_t now) {
+  cpu_t elapsed = now - p->p_periodStart;
+  if (elapsed >= p->p_quota.q_period) {
+    p->p_periodStart += elapsed - (elapsed % p->p_quota.q_period);
+    p->p_periodUsed = 0;
+  }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file rrPolicy.c
+ * @author Dang Truong, Loc Pham
+ * @brief Implements the default scheduling policy: round-robin. Ready queues
+ * are FIFO, every process gets a time slice of QUANTUM (5ms), and a process
+ * goes to the tail of the queue whether it was preempted, woken or created.
+ * @date 2025-05-26
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/const.h"
+#include "../h/pcb.h"
+#include "../h/scheduler.h"
+#include "../h/types.h"
+
+/*====================Local function declarations====================*/
+
+HIDDEN void rrEnqueue(pcb_PTR *queue, pcb_PTR p);
+HIDDEN pcb_PTR rrDequeue(pcb_PTR *queue, int (*canRun)(pcb_PTR p));
+HIDDEN pcb_PTR rrRemove(pcb_PTR *queue, pcb_PTR p);
+HIDDEN int rrEmpty(pcb_PTR queue);
+HIDDEN void rrNoEvent(pcb_PTR p);
+HIDDEN unsigned int rrQuantum(pcb_PTR p);
+
+/* The policy's operations */
+schedPolicy_t rrPolicy = {rrEnqueue, rrDequeue, rrRemove,  rrEmpty,
+                          rrNoEvent, rrNoEvent, rrNoEvent, rrQuantum};
+
+/*====================Local function definitions====================*/
+
+/**
+ * @brief Insert a process at the tail of a ready queue.
+ *
+ * @param queue Tail pointer of the queue.
+ * @param p The process.
+ */
+HIDDEN void rrEnqueue(pcb_PTR *queue, pcb_PTR p) { insertProcQ(queue, p); }
+
+/**
+ * @brief Remove the oldest process of a ready queue that may run.
+ *
+ * @param queue Tail pointer of the queue.
+ * @param canRun Tells whether a process may run.
+ * @return The process, or NULL if there is none.
+ */
+HIDDEN pcb_PTR rrDequeue(pcb_PTR *queue, int (*canRun)(pcb_PTR p)) {
+  pcb_PTR head = headProcQ(*queue);
+  pcb_PTR q = head;
+  while (q != NULL) {
+    if (canRun(q)) {
+      return outProcQ(queue, q);
+    }
+    q = (q->p_next == head) ? NULL : q->p_next;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Remove a given process from a ready queue.
+ *
+ * @param queue Tail pointer of the queue.
+ * @param p The process.
+ * @return p, or NULL if it is not on the queue.
+ */
+HIDDEN pcb_PTR rrRemove(pcb_PTR *queue, pcb_PTR p) {
+  return outProcQ(queue, p);
+}
+
+/**
+ * @brief Tell whether a ready queue is empty.
+ *
+ * @param queue Tail pointer of the queue.
+ * @return TRUE if it holds no process, FALSE otherwise.
+ */
+HIDDEN int rrEmpty(pcb_PTR queue) { return emptyProcQ(queue); }
+
+/**
+ * @brief Ignore a scheduling event: round-robin keeps no per-process state.
+ *
+ * @param p The process.
+ */
+HIDDEN void rrNoEvent(pcb_PTR p) {}
+
+/**
+ * @brief Give a process the fixed time slice.
+ *
+ * @param p The process.
+ * @return QUANTUM.
+ */
+HIDDEN unsigned int rrQuantum(pcb_PTR p) { return QUANTUM; }
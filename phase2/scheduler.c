@@ -2,8 +2,10 @@
  * @file scheduler.c
  * @author Dang Truong, Loc Pham
  * @brief This module implements the scheduler functionality for Phase 2. It is
- * responsible for dispatching processes from the ready queue using a
- * round-robin scheduling algorithm with a time slice of 5 milliseconds.
+ * responsible for dispatching processes from the per-processor ready queues;
+ * an idle processor steals work from the others. The order of each queue and
+ * the length of time slices are left to the scheduling policy chosen at build
+ * time (SCHED_POLICY, round-robin with 5ms time slices by default).
  * Additionally, it provides critical wrapper functions for context switching
  * using the LDST and LDCXT instructions.
  * @date 2025-04-17
@@ -14,73 +16,210 @@
 
 #include "../h/scheduler.h"
 
+#include "../h/exceptions.h"
 #include "../h/initial.h"
 #include "../h/pcb.h"
+#include "../h/quota.h"
+#include "../h/smp.h"
 #include "umps3/umps/libumps.h"
 
-/* Timestamp (in microseconds) when the current process's time slice began. */
-cpu_t quantumStartTime = 0;
+/* Per processor, timestamp (in microseconds) since which the current process's
+ * CPU time is not yet charged. */
+cpu_t chargeStartTimes[NUM_CPUS];
+
+/* Per processor, tail pointer to a queue of pcbs that are in the "ready" state,
+ * and the lock guarding it */
+HIDDEN pcb_PTR readyQueues[NUM_CPUS];
+HIDDEN volatile unsigned int readyLocks[NUM_CPUS];
+
+/* The scheduling policy chosen at build time */
+#define policy SCHED_POLICY
+
+/*====================Local function declarations====================*/
+
+HIDDEN int onlyOnCPU0(pcb_PTR p);
+HIDDEN int anyProc(pcb_PTR p);
+HIDDEN int mayMigrate(pcb_PTR p);
+HIDDEN pcb_PTR takeReady(int cpu);
+HIDDEN int busyElsewhere();
+
+/*====================Global function definitions====================*/
 
 /**
  * @brief Load a new processor state using the LDST instruction.
  *
  * LDST replaces the current process context with the one specified by `state`.
  * This is a privileged operation that does not return if successful.
- * Should only be invoked via this wrapper for safety and clarity.
+ * Should only be invoked via this wrapper for safety and clarity: the time the
+ * current process spent since it was last charged, in the Nucleus or in kernel
+ * mode, is charged as kernel time first.
  *
  * @param state Pointer to the processor state to load.
  * @return This function does not return; control is transferred to the new
  * state.
  */
-void switchContext(state_t *state) { LDST(state); }
+void switchContext(state_t *state) {
+  if (currentProc != NULL) {
+    chargeCPU(currentProc, FALSE);
+  }
+  LDST(state);
+}
 
 /**
  * @brief Atomically load a new processor context using LDCXT.
  *
  * Loads a full processor context, including stack pointer, status register,
  * and program counter. Used when passing control to support-level exception
- * handlers.
+ * handlers; the current process is charged as for switchContext().
  *
  * @param context Pointer to the context structure to load.
  * @return This function does not return; control is transferred to the new
  * context.
  */
 void loadContext(context_t *context) {
+  if (currentProc != NULL) {
+    chargeCPU(currentProc, FALSE);
+  }
   LDCXT(context->c_stackPtr, context->c_status, context->c_pc);
 }
 
 /**
- * @brief Round-robin scheduler for selecting and dispatching processes.
+ * @brief Initialize the ready queues to empty.
+ */
+void initReadyQueues() {
+  int cpu;
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    readyQueues[cpu] = mkEmptyProcQ();
+    readyLocks[cpu] = UNLOCKED;
+    chargeStartTimes[cpu] = 0;
+  }
+}
+
+/**
+ * @brief Insert a process into a ready queue, where the policy places it.
+ *
+ * A process that only processor 0 may run (see onlyOnCPU0()) goes on
+ * processor 0's queue; any other process goes on the calling processor's
+ * queue, from which an idle processor may steal it.
  *
- * Removes the next process from the ready queue and:
- * - If no processes exist, halts the system (successful termination).
- * - If all processes are blocked, enables interrupts and disables the PLT, then
- * waits for a device interrupt.
- * - Otherwise, invokes PANIC due to a deadlock or invalid state.
+ * @param p The process that is ready to run.
+ */
+void makeReady(pcb_PTR p) {
+  int cpu = onlyOnCPU0(p) ? CPU0 : getPRID();
+  acquireLock(&readyLocks[cpu]);
+  policy.sp_enqueue(&readyQueues[cpu], p);
+  releaseLock(&readyLocks[cpu]);
+}
+
+/**
+ * @brief Make a process that was blocked on a semaphore ready.
  *
- * If a ready process is found:
+ * @param p The process.
+ */
+void wakeProc(pcb_PTR p) {
+  policy.sp_onWake(p);
+  makeReady(p);
+}
+
+/**
+ * @brief Make the current process ready again at the end of its time slice.
+ *
+ * @param p The process.
+ */
+void preemptProc(pcb_PTR p) {
+  policy.sp_onTick(p);
+  makeReady(p);
+}
+
+/**
+ * @brief Tell the policy that the current process is blocking on a semaphore.
+ *
+ * @param p The process.
+ */
+void blockProc(pcb_PTR p) { policy.sp_onBlock(p); }
+
+/**
+ * @brief Remove a process from whichever ready queue holds it.
+ *
+ * @param p The process.
+ * @return p, or NULL if it is on no ready queue (it is running, or on its way
+ * to another queue).
+ */
+pcb_PTR outReady(pcb_PTR p) {
+  int cpu;
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    acquireLock(&readyLocks[cpu]);
+    pcb_PTR q = policy.sp_remove(&readyQueues[cpu], p);
+    releaseLock(&readyLocks[cpu]);
+    if (q != NULL) {
+      return q;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Scheduler for selecting and dispatching processes on the calling
+ * processor.
+ *
+ * Removes the next process from the processor's ready queue, or steals one
+ * from another processor's queue if it is empty. If there is none:
+ * - On processor 0, if no processes exist, halts the system (successful
+ * termination). If some are blocked or run on other processors, enables
+ * interrupts and waits; the PLT is disabled unless there are other processors
+ * to steal work from. Otherwise, invokes PANIC due to a deadlock.
+ * - On the other processors, enables interrupts and waits for the PLT to look
+ * for work again.
+ *
+ * Processes killed while away from processor 0 are freed, and processes over
+ * their CPU budget are throttled (or handed over to processor 0). If a ready
+ * process is found:
  * - Sets it as `currentProc`
- * - Records the current time as `quantumStartTime`
- * - Loads the processor timer with a 5ms time slice
- * - Performs a context switch to the selected process
+ * - Records the current time as `chargeStartTime`, the start of its time
+ * slice
+ * - Loads the processor timer with the time slice the policy gives it, cut
+ * short by its CPU quota
+ * - Handles the exception the process raised on another processor, if any,
+ * stops it if it reached its CPU time limit, or else performs a context switch
+ * to the selected process
  *
  * @return This function does not return; control is passed via switchContext or
  * HALT/WAIT/PANIC.
  */
 void scheduler() {
-  pcb_PTR p = removeProcQ(&readyQueue);
+  int cpu = getPRID();
+  pcb_PTR p;
+  while ((p = takeReady(cpu)) != NULL &&
+         (p->p_killed || (!p->p_forward && overBudget(p)))) {
+    if (cpu != CPU0) {
+      makeReady(p);
+    } else if (p->p_killed) {
+      /* Terminated while it ran elsewhere */
+      freePcb(p);
+    } else {
+      /* Sleeps until its next period */
+      quotaThrottle(p);
+    }
+    currentProc = NULL;
+  }
+
   if (p == NULL) {
-    /* The Ready Queue is empty */
-    if (procCnt == 0) {
+    /* The Ready Queues are empty */
+    unsigned int currentStatus = getSTATUS() | STATUS_IEC;
+    if (cpu != CPU0 || NUM_CPUS > 1) {
+      /* Keep the PLT running to look for work to steal */
+      setTIMER(IDLE_POLL);
+      currentStatus |= STATUS_TE;
+    } else {
+      currentStatus &= ~STATUS_TE;
+    }
+
+    if (cpu == CPU0 && procCnt == 0) {
       /* Job well done */
       HALT();
-    } else if (procCnt > 0 && softBlockCnt > 0) {
-      /* Enable global interrupts and disable the PLT */
-      unsigned int currentStatus = getSTATUS();
-      currentStatus |= STATUS_IEC;
-      currentStatus &= ~STATUS_TE;
+    } else if (cpu != CPU0 || softBlockCnt > 0 || busyElsewhere()) {
+      /* Enable global interrupts, waiting for an interrupt to occur */
       setSTATUS(currentStatus);
-      /* Waiting for a device interrupt to occur */
       WAIT();
     } else {
       /* Deadlock or abnormal case */
@@ -88,9 +227,105 @@ void scheduler() {
     }
   }
 
-  /* Set new current process and start its quantum */
-  currentProc = p;
-  STCK(quantumStartTime);
-  setTIMER(QUANTUM); /* Each process gets a time slice of 5ms */
+  /* Start the quantum of the new current process, set by takeReady() */
+  STCK(chargeStartTime);
+  setTIMER(quotaSlice(p, policy.sp_quantum(p)));
+  tlbSync();
+  if (p->p_forward) {
+    /* Handle the exception p raised on another processor, as if raised here */
+    p->p_forward = FALSE;
+    copyState(CPU_STATE(cpu), &p->p_s);
+    generalExceptionHandler();
+  }
+  if (overLimit(p) && cpu == CPU0) {
+    copyState(CPU_STATE(cpu), &p->p_s);
+    stopOverLimit(CPU_STATE(cpu));
+  }
   switchContext(&p->p_s);
 }
+
+/*====================Local function definitions====================*/
+
+/**
+ * @brief Check whether only processor 0 may run a process: one in kernel mode
+ * (Nucleus and Support Level code), one with an exception left for processor
+ * 0 to handle, one killed while away from processor 0, or one its CPU quota
+ * stops or throttles.
+ *
+ * @param p The process.
+ * @return TRUE if p must run on processor 0, FALSE otherwise.
+ */
+HIDDEN int onlyOnCPU0(pcb_PTR p) {
+  return !(p->p_s.s_status & STATUS_KUP) || p->p_forward || p->p_killed ||
+         overLimit(p) || overBudget(p);
+}
+
+/**
+ * @brief Check whether a process may run on any processor.
+ *
+ * @param p The process.
+ * @return TRUE.
+ */
+HIDDEN int anyProc(pcb_PTR p) { return TRUE; }
+
+/**
+ * @brief Check whether a process may run on a processor other than 0.
+ *
+ * @param p The process.
+ * @return TRUE if so, FALSE otherwise.
+ */
+HIDDEN int mayMigrate(pcb_PTR p) { return !onlyOnCPU0(p); }
+
+/**
+ * @brief Remove the process a processor runs next and make it the processor's
+ * current process.
+ *
+ * Takes the process the policy picks from the processor's own queue; if that
+ * is empty, steals one it may run from another processor's queue.
+ *
+ * @param cpu The calling processor.
+ * @return The process, or NULL if there is none.
+ */
+HIDDEN pcb_PTR takeReady(int cpu) {
+  pcb_PTR p = NULL;
+  int i;
+  for (i = 0; i < NUM_CPUS && p == NULL; i++) {
+    int victim = (cpu + i) % NUM_CPUS;
+    acquireLock(&readyLocks[victim]);
+    p = policy.sp_dequeue(&readyQueues[victim],
+                          (victim == cpu || cpu == CPU0) ? anyProc
+                                                         : mayMigrate);
+    /* Set under the lock, so that the process is always either queued or
+     * current for busyElsewhere() */
+    currentProcs[cpu] = p;
+    releaseLock(&readyLocks[victim]);
+  }
+  return p;
+}
+
+/**
+ * @brief Check, on processor 0, whether another processor runs a process or
+ * any process is ready.
+ *
+ * Holds every ready queue lock at once, so that a process moving between
+ * processors is seen somewhere.
+ *
+ * @return TRUE if so, FALSE otherwise.
+ */
+HIDDEN int busyElsewhere() {
+  int busy = FALSE;
+  int cpu;
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    acquireLock(&readyLocks[cpu]);
+  }
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    if (!policy.sp_empty(readyQueues[cpu]) ||
+        (cpu != CPU0 && currentProcs[cpu] != NULL)) {
+      busy = TRUE;
+    }
+  }
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    releaseLock(&readyLocks[cpu]);
+  }
+  return busy;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file smp.c
+ * @author Dang Truong, Loc Pham
+ * @brief This module brings up the other processors of a multiprocessor
+ * machine and provides the primitives they share: spin locks and TLB
+ * shootdown.
+ *
+ * Processor 0 runs every Nucleus service and every process in kernel mode, so
+ * the ASL, the pcb pool, the device semaphores, the timers and the Support
+ * Level critical sections (which disable interrupts) are only ever touched by
+ * one processor. All device interrupts are routed to it. The other processors
+ * run processes in user mode: they handle the PLT and TLB refills themselves
+ * and hand any other exception over to processor 0 (see
+ * generalExceptionHandler()). Each processor has its own Pass Up Vector,
+ * Nucleus stack, current process, time slice and ready queue; the ready
+ * queues are the only Nucleus structures shared between processors and each
+ * is guarded by a spin lock.
+ * @date 2025-05-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/smp.h"
+
+#include "../h/exceptions.h"
+#include "../h/initial.h"
+#include "../h/scheduler.h"
+#include "umps3/umps/libumps.h"
+
+/* Function from phase 3 */
+extern void uTLB_RefillHandler();
+
+#if NUM_CPUS > 1
+/* Nucleus stacks and initial states of processors 1 to NUM_CPUS - 1;
+ * processor 0 uses the page below STACKTOP */
+HIDDEN unsigned int cpuStacks[NUM_CPUS - 1][PAGESIZE / WORDLEN];
+HIDDEN state_t cpuStartStates[NUM_CPUS - 1];
+#endif
+
+/* TRUE until a processor has flushed its TLB after a shootdown */
+HIDDEN volatile unsigned int tlbStale[NUM_CPUS];
+
+/*====================Global function definitions====================*/
+
+/**
+ * @brief Acquire a spin lock.
+ *
+ * Must be called with interrupts disabled, and the lock must not be held
+ * across a context switch.
+ *
+ * @param lock The lock (UNLOCKED or LOCKED).
+ */
+void acquireLock(volatile unsigned int *lock) {
+  while (!CAS(lock, UNLOCKED, LOCKED)) {
+    ; /* Spin until the holder releases it */
+  }
+}
+
+/**
+ * @brief Release a spin lock acquired with acquireLock().
+ *
+ * @param lock The lock.
+ */
+void releaseLock(volatile unsigned int *lock) { *lock = UNLOCKED; }
+
+/**
+ * @brief Route the device interrupts to processor 0 and start the other
+ * processors.
+ *
+ * Each processor gets a Pass Up Vector with its own Nucleus stack and starts
+ * in the scheduler in kernel mode with interrupts disabled, where it waits for
+ * work to steal. Must be called by processor 0 once the Nucleus is
+ * initialized.
+ */
+void startCPUs() {
+  unsigned int *irt = (unsigned int *)IRT_BASE;
+  int i;
+  for (i = 0; i < IRT_ENTRIES; i++) {
+    irt[i] = IRT_TO_CPU0;
+  }
+  for (i = 0; i < NUM_CPUS; i++) {
+    tlbStale[i] = FALSE;
+  }
+
+#if NUM_CPUS > 1
+  int cpu;
+  for (cpu = 1; cpu < NUM_CPUS; cpu++) {
+    /* Stack pointers must be doubleword aligned */
+    memaddr stackTop = (memaddr)&cpuStacks[cpu - 1][PAGESIZE / WORDLEN] & ~0x7;
+
+    passupvector_t *passUpVector = CPU_PASSUPVECTOR(cpu);
+    passUpVector->tlb_refll_handler = (memaddr)uTLB_RefillHandler;
+    passUpVector->tlb_refll_stackPtr = stackTop;
+    passUpVector->execption_handler = (memaddr)generalExceptionHandler;
+    passUpVector->exception_stackPtr = stackTop;
+
+    state_t *startState = &cpuStartStates[cpu - 1];
+    for (i = 0; i < STATEREGNUM; i++) {
+      startState->s_reg[i] = 0;
+    }
+    startState->s_entryHI = 0;
+    startState->s_cause = 0;
+    /* Kernel mode, interrupts disabled until the scheduler waits for them */
+    startState->s_status = ZERO_MASK | STATUS_IM_ALL_ON;
+    startState->s_pc = (memaddr)scheduler;
+    startState->s_t9 = (memaddr)scheduler;
+    startState->s_sp = stackTop;
+    INITCPU(cpu, startState);
+  }
+#endif
+}
+
+/**
+ * @brief Make every other processor flush its TLB, after a Page Table entry
+ * was invalidated or write-protected.
+ *
+ * Sends the other processors an inter-processor interrupt and returns once
+ * each has acknowledged it by flushing (see tlbSync()). The caller flushes or
+ * updates its own TLB.
+ */
+void tlbShootdown() {
+  int self = getPRID();
+  unsigned int recipients = 0;
+  int cpu;
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    if (cpu != self) {
+      tlbStale[cpu] = TRUE;
+      recipients |= IPI_TO(cpu);
+    }
+  }
+  if (recipients == 0) {
+    return;
+  }
+
+  /* Interrupt them rather than wait for their next exception */
+  *((volatile unsigned int *)CPU_OUTBOX) = recipients | IPI_TLB_FLUSH;
+  for (cpu = 0; cpu < NUM_CPUS; cpu++) {
+    while (cpu != self && tlbStale[cpu]) {
+      ; /* Spin until it acknowledges */
+    }
+  }
+}
+
+/**
+ * @brief Flush the TLB of the calling processor if a shootdown asked for it,
+ * acknowledging the shootdown.
+ *
+ * Called on every entry to the Nucleus, including the inter-processor
+ * interrupt a shootdown sends, and before dispatching a process.
+ */
+void tlbSync() {
+  int self = getPRID();
+  if (tlbStale[self]) {
+    TLBCLR();
+    tlbStale[self] = FALSE;
+  }
+}
@@ -0,0 +1,246 @@
+/**
+ * @file timers.c
+ * @author Dang Truong, Loc Pham
+ * @brief This module multiplexes the Interval Timer between the 100ms
+ * pseudo-clock tick and processes waiting for a deadline: sleepers (SYS44)
+ * and processes blocked in a P with a timeout (SYS45). The timed waiters are
+ * kept in a binary min-heap ordered by deadline, and the Interval Timer is
+ * always loaded with the time left until the earlier of the next tick and the
+ * earliest deadline, so timed waiters are woken at their deadline rather than
+ * at the next tick.
+ * @date 2025-05-07
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/timers.h"
+
+#include "../h/asl.h"
+#include "../h/initial.h"
+#include "../h/pcb.h"
+#include "../h/scheduler.h"
+
+/* Timed sleeper: a process and the TOD at which it must be woken */
+typedef struct timerd_t {
+  cpu_t t_deadline; /* wake-up time (microseconds since boot) */
+  pcb_PTR t_proc;   /* sleeping process                       */
+} timerd_t;
+
+/* Semaphore processes sleeping in SYS44 are blocked on. Like the pseudo-clock
+ * semaphore it is only a key in the ASL: sleepers are woken by the Interval
+ * Timer handler and its value stays 0 */
+int timerSem;
+
+/* Binary min-heap of timed waiters (every process could be one) */
+HIDDEN timerd_t timerHeap[MAXPROC];
+HIDDEN int timerCount;
+
+/* TOD of the next pseudo-clock tick */
+HIDDEN cpu_t nextTickTime;
+
+/* ==================== Local Function Declarations ==================== */
+HIDDEN void timerArm();
+HIDDEN void pseudoClockTick();
+HIDDEN void heapSwap(int i, int j);
+HIDDEN void heapUp(int i);
+HIDDEN void heapDown(int i);
+HIDDEN pcb_PTR heapRemove(int i);
+
+/* ==================== Public Function Definitions ==================== */
+
+/**
+ * @brief Initialize the timer module and start the pseudo-clock.
+ */
+void initTimers() {
+  timerSem = 0;
+  timerCount = 0;
+
+  cpu_t now;
+  STCK(now);
+  nextTickTime = now + SYSTEM_TICK_INTERVAL;
+  LDIT(SYSTEM_TICK_INTERVAL);
+}
+
+/**
+ * @brief Check whether a semaphore is the SYS44 sleep semaphore.
+ *
+ * @param sem Pointer to the semaphore.
+ * @return TRUE if sem is the timer semaphore.
+ */
+int isTimerSem(int *sem) { return sem == &timerSem; }
+
+/**
+ * @brief Add a process to the timed sleepers and reprogram the Interval Timer
+ * if its deadline is now the earliest. The caller blocks the process.
+ *
+ * @param p Process that will sleep.
+ * @param deadline TOD (microseconds) at which p must be woken.
+ */
+void timerInsert(pcb_PTR p, cpu_t deadline) {
+  timerHeap[timerCount].t_deadline = deadline;
+  timerHeap[timerCount].t_proc = p;
+  timerCount++;
+  p->p_timed = TRUE;
+  heapUp(timerCount - 1);
+
+  if (timerHeap[0].t_proc == p) {
+    timerArm();
+  }
+}
+
+/**
+ * @brief Remove a process from the timed waiters (because it is being
+ * terminated, or its timed P was satisfied by a V). Does nothing if the
+ * process is not a timed waiter.
+ *
+ * @param p The process to remove.
+ */
+void timerCancel(pcb_PTR p) {
+  if (!p->p_timed) {
+    return;
+  }
+
+  int i;
+  for (i = 0; i < timerCount; i++) {
+    if (timerHeap[i].t_proc == p) {
+      heapRemove(i);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Handle an Interval Timer interrupt.
+ *
+ * Performs the pseudo-clock tick if it is due, moves every timed waiter whose
+ * deadline has passed to the ready queue, and reloads the Interval Timer for
+ * the next event (which also acknowledges the interrupt). A process whose
+ * timed P expired has its P undone: the semaphore gets back the unit it took
+ * and SYS45 returns SEM_TIMEOUT.
+ */
+void timerInterrupt() {
+  cpu_t now;
+  STCK(now);
+
+  if (now >= nextTickTime) {
+    pseudoClockTick();
+    nextTickTime += SYSTEM_TICK_INTERVAL;
+    if (nextTickTime <= now) {
+      /* Ticks were missed (e.g. interrupts were masked): resynchronize */
+      nextTickTime = now + SYSTEM_TICK_INTERVAL;
+    }
+  }
+
+  while (timerCount > 0 && timerHeap[0].t_deadline <= now) {
+    pcb_PTR p = heapRemove(0);
+    int *sem = p->p_semAdd;
+    outBlocked(p);
+    if (!isTimerSem(sem)) {
+      (*sem)++;
+      p->p_s.s_v0 = SEM_TIMEOUT;
+    }
+    wakeProc(p);
+    softBlockCnt--;
+  }
+
+  timerArm();
+}
+
+/* ==================== Local Function Definitions ==================== */
+
+/**
+ * @brief Load the Interval Timer with the time left until the next event: the
+ * next pseudo-clock tick or the earliest sleeper's deadline.
+ */
+HIDDEN void timerArm() {
+  cpu_t next = nextTickTime;
+  if (timerCount > 0 && timerHeap[0].t_deadline < next) {
+    next = timerHeap[0].t_deadline;
+  }
+
+  cpu_t now;
+  STCK(now);
+  LDIT(next > now ? next - now : 1);
+}
+
+/**
+ * @brief Unblock all processes waiting on the pseudo-clock semaphore and reset
+ * that semaphore to 0.
+ */
+HIDDEN void pseudoClockTick() {
+  int *pseudoSem = &deviceSem[PSEUDOCLOCK];
+  pcb_PTR p;
+  while ((p = removeBlocked(pseudoSem)) != NULL) {
+    wakeProc(p);
+    softBlockCnt--;
+  }
+
+  /* Reset pseudo-clock semaphore */
+  *pseudoSem = 0;
+}
+
+/* ==================== Heap Helpers ==================== */
+
+/**
+ * @brief Swap two heap entries.
+ */
+HIDDEN void heapSwap(int i, int j) {
+  timerd_t tmp = timerHeap[i];
+  timerHeap[i] = timerHeap[j];
+  timerHeap[j] = tmp;
+}
+
+/**
+ * @brief Move entry i up until its parent's deadline is not later.
+ */
+HIDDEN void heapUp(int i) {
+  while (i > 0 &&
+         timerHeap[(i - 1) / 2].t_deadline > timerHeap[i].t_deadline) {
+    heapSwap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+/**
+ * @brief Move entry i down until neither child's deadline is earlier.
+ */
+HIDDEN void heapDown(int i) {
+  while (TRUE) {
+    int smallest = i;
+    int left = 2 * i + 1;
+    int right = 2 * i + 2;
+    if (left < timerCount &&
+        timerHeap[left].t_deadline < timerHeap[smallest].t_deadline) {
+      smallest = left;
+    }
+    if (right < timerCount &&
+        timerHeap[right].t_deadline < timerHeap[smallest].t_deadline) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    heapSwap(i, smallest);
+    i = smallest;
+  }
+}
+
+/**
+ * @brief Remove heap entry i and restore the heap order.
+ *
+ * @return The process of the removed entry.
+ */
+HIDDEN pcb_PTR heapRemove(int i) {
+  pcb_PTR p = timerHeap[i].t_proc;
+  p->p_timed = FALSE;
+
+  timerCount--;
+  if (i < timerCount) {
+    timerHeap[i] = timerHeap[timerCount];
+    heapUp(i);
+    heapDown(i);
+  }
+
+  return p;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file waitAny.c
+ * @author Dang Truong, Loc Pham
+ * @brief This module lets a process wait for the first of several devices to
+ * complete (SYS46). A pcb can only be blocked on one semaphore, so the waiter
+ * is blocked on the waitAnySem key and one watch entry per device is queued
+ * on that device instead. Each watch performs the P of a SYS5 on its device
+ * semaphore.
+ *
+ * When a device completes and no SYS5 caller is waiting on it, the interrupt
+ * handler hands the completion to the oldest watch on that device. Its process
+ * is woken with the status, and its watches on the other devices are
+ * cancelled: they are dequeued and their P is undone, so a completion that
+ * arrives later on one of those devices is kept in its semaphore as for any
+ * V nobody was waiting for.
+ * @date 2025-05-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/waitAny.h"
+
+#include "../h/asl.h"
+#include "../h/initial.h"
+#include "../h/pcb.h"
+#include "../h/scheduler.h"
+
+/* A process waiting on one device as part of a SYS46 */
+typedef struct watchd_t {
+  struct watchd_t *w_next; /* next watch on the same device / free list */
+  pcb_PTR w_proc;          /* waiting process                           */
+  int w_devIdx;            /* device semaphore index                    */
+  int w_slot;              /* index of the device in the SYS46 request  */
+} watchd_t;
+
+/* Semaphore SYS46 callers are blocked on. Like the pseudo-clock semaphore it
+ * is only a key in the ASL: the waiters are woken by the device interrupt
+ * handler and its value stays 0 */
+int waitAnySem;
+
+HIDDEN watchd_t watchTable[MAXPROC * WAITANY_MAX];
+HIDDEN watchd_t *watchFree;
+
+/* FIFO of watches on each device semaphore */
+HIDDEN watchd_t *watchHead[NUMDEVICES];
+HIDDEN watchd_t *watchTail[NUMDEVICES];
+
+/* ==================== Local Function Declarations ==================== */
+HIDDEN void watchRemove(watchd_t *w);
+
+/* ==================== Public Function Definitions ==================== */
+
+/**
+ * @brief Initialize the watch free list and the per-device watch queues.
+ */
+void initWaitAny() {
+  waitAnySem = 0;
+  watchFree = NULL;
+
+  int i;
+  for (i = 0; i < MAXPROC * WAITANY_MAX; i++) {
+    watchTable[i].w_proc = NULL;
+    watchTable[i].w_next = watchFree;
+    watchFree = &watchTable[i];
+  }
+
+  for (i = 0; i < NUMDEVICES; i++) {
+    watchHead[i] = NULL;
+    watchTail[i] = NULL;
+  }
+}
+
+/**
+ * @brief Check whether a semaphore is the SYS46 wait-any semaphore.
+ *
+ * @param sem Pointer to the semaphore.
+ * @return TRUE if sem is the wait-any semaphore.
+ */
+int isWaitAnySem(int *sem) { return sem == &waitAnySem; }
+
+/**
+ * @brief Make a process watch a device: perform the P on the device semaphore
+ * and queue a watch entry behind the earlier ones on that device. The caller
+ * blocks the process on waitAnySem once all its devices are watched.
+ *
+ * @param p Process that will wait.
+ * @param devIdx Device semaphore index (0-47).
+ * @param slot Index of the device in the caller's request (returned in s_v0).
+ * @return TRUE on success, FALSE if no watch entry is free.
+ */
+int waitAnyAdd(pcb_PTR p, int devIdx, int slot) {
+  watchd_t *w = watchFree;
+  if (w == NULL) {
+    return FALSE;
+  }
+  watchFree = w->w_next;
+
+  w->w_next = NULL;
+  w->w_proc = p;
+  w->w_devIdx = devIdx;
+  w->w_slot = slot;
+
+  if (watchTail[devIdx] == NULL) {
+    watchHead[devIdx] = w;
+  } else {
+    watchTail[devIdx]->w_next = w;
+  }
+  watchTail[devIdx] = w;
+
+  deviceSem[devIdx]--;
+  return TRUE;
+}
+
+/**
+ * @brief Cancel every watch of a process (because it is being terminated or
+ * one of its devices completed), undoing the P each watch performed.
+ *
+ * @param p The process whose watches are cancelled.
+ */
+void waitAnyCancel(pcb_PTR p) {
+  int i;
+  for (i = 0; i < MAXPROC * WAITANY_MAX; i++) {
+    watchd_t *w = &watchTable[i];
+    if (w->w_proc == p) {
+      deviceSem[w->w_devIdx]++;
+      watchRemove(w);
+    }
+  }
+}
+
+/**
+ * @brief Hand a device completion to the oldest process watching the device.
+ *
+ * Called by the device interrupt handler after its V on the device semaphore,
+ * when no SYS5 caller was waiting. That V matches the P of the winning watch;
+ * the process's other watches are cancelled and it is moved to the ready
+ * queue with the index of the device in s_v0 and the status in s_v1.
+ *
+ * @param devIdx Device semaphore index (0-47).
+ * @param statusCode Status of the completed operation.
+ * @return TRUE if a waiting process consumed the completion.
+ */
+int waitAnyInterrupt(int devIdx, unsigned int statusCode) {
+  watchd_t *w = watchHead[devIdx];
+  if (w == NULL) {
+    return FALSE;
+  }
+
+  pcb_PTR p = w->w_proc;
+  p->p_s.s_v0 = w->w_slot;
+  p->p_s.s_v1 = statusCode;
+  watchRemove(w);
+  waitAnyCancel(p);
+
+  outBlocked(p);
+  wakeProc(p);
+  softBlockCnt--;
+  return TRUE;
+}
+
+/* ==================== Local Function Definitions ==================== */
+
+/**
+ * @brief Dequeue a watch from its device queue and return it to the free list.
+ */
+HIDDEN void watchRemove(watchd_t *w) {
+  int devIdx = w->w_devIdx;
+  watchd_t *prev = NULL;
+  watchd_t *cur = watchHead[devIdx];
+  while (cur != w) {
+    prev = cur;
+    cur = cur->w_next;
+  }
+
+  if (prev == NULL) {
+    watchHead[devIdx] = w->w_next;
+  } else {
+    prev->w_next = w->w_next;
+  }
+  if (watchTail[devIdx] == w) {
+    watchTail[devIdx] = prev;
+  }
+
+  w->w_proc = NULL;
+  w->w_next = watchFree;
+  watchFree = w;
+}
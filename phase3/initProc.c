@@ -18,17 +18,51 @@
 #include "../h/delayDaemon.h"
 #include "../h/deviceSupportDMA.h"
 #include "../h/exceptions.h"
+#include "../h/pipe.h"
+#include "../h/printSpooler.h"
 #include "../h/supportAlloc.h"
 #include "../h/sysSupport.h"
+#include "../h/thread.h"
 #include "../h/vmSupport.h"
 #include "umps3/umps/libumps.h"
 
 /* Support Level's global variables */
 int masterSemaphore;              /* Master semaphore for termination */
+int liveUProcs;                   /* U-procs (forked ones too) still running */
 int supportDeviceSem[NUMDEVICES]; /* support level device semaphore */
 
 pte_t globalPgTbl[KUSEGSHARE_PAGES];
 
+/* Devices of the U-procs init() launches, in ASID order: the flash device
+ * holding the image, the terminal and the printer. Several U-procs may share a
+ * device. By default the image on each flash device runs once; building with
+ * MANY_UPROCS=1 (see the Makefiles) runs each image twice, on 16 U-procs. As
+ * many U-procs are launched as the table, RAM and DISK0 allow */
+HIDDEN devBinding_t uProcBinding[] = {
+    {0, 0, 0}, {1, 1, 1}, {2, 2, 2}, {3, 3, 3},
+    {4, 4, 4}, {5, 5, 5}, {6, 6, 6}, {7, 7, 7},
+#if MANY_UPROCS
+    {0, 0, 0}, {1, 1, 1}, {2, 2, 2}, {3, 3, 3},
+    {4, 4, 4}, {5, 5, 5}, {6, 6, 6}, {7, 7, 7},
+#endif
+};
+#define NUM_BINDINGS ((int)(sizeof(uProcBinding) / sizeof(devBinding_t)))
+
+/* Flash devices whose image header has been read, in completion order */
+HIDDEN int imageReadySem;              /* V'd by each image helper */
+HIDDEN int imageReadyFlash[DEVPERINT]; /* flash numbers, in completion order */
+HIDDEN int imageReadyCount;
+HIDDEN int imageError;                 /* TRUE if a helper got a flash error */
+HIDDEN int imagePages[DEVPERINT];      /* .text/.data pages of each image */
+
+/* Support structures of the U-procs to launch, indexed by ASID - 1 */
+HIDDEN support_t *uProcSupport[MAX_UPROCS];
+HIDDEN int numUProcs;
+
+/* CPU time quota of every U-proc launched */
+HIDDEN quota_t uProcQuota = {UPROC_CPU_LIMIT, UPROC_CPU_BUDGET,
+                             UPROC_CPU_PERIOD};
+
 /**
  * @brief Initialize the processor state of a U-proc for execution.
  *
@@ -40,7 +74,7 @@ pte_t globalPgTbl[KUSEGSHARE_PAGES];
  * state.
  * @param asid Address Space Identifier (ASID) for the U-proc.
  */
-HIDDEN void initUProcState(state_t *state, int asid) {
+void initUProcState(state_t *state, int asid) {
   state->s_pc = state->s_t9 = UPROC_PC;
   state->s_sp = UPROC_SP;
   state->s_status = STATUS_KUP | STATUS_IEP | STATUS_IM_ALL_ON | STATUS_TE;
@@ -70,92 +104,135 @@ HIDDEN void initPageTable(support_t *sup, int asid) {
 }
 
 /**
- * @brief Initialize the support structure for a U-proc.
+ * @brief Initialize the support structure for a U-proc, which runs with the
+ * ASID of the structure.
  *
- * Sets the ASID, private semaphore, configures the exception contexts for TLB
- * refill and general exceptions with their respective handlers and stack areas,
- * and initializes the private page table using `initPageTable`.
+ * Sets the private semaphore, configures the exception contexts for TLB refill
+ * and general exceptions with their respective handlers and the stacks the
+ * structure was allocated with, and initializes the private page table using
+ * `initPageTable`. The caller binds the U-proc to its devices.
  *
  * @param sup Pointer to the support structure.
- * @param asid Address Space Identifier (ASID) for the U-proc.
  */
-HIDDEN void initSupportStruct(support_t *sup, int asid) {
-  /* Set ASID for the process */
-  sup->sup_asid = asid;
+void initSupportStruct(support_t *sup) {
+  int asid = sup->sup_asid;
 
   /* Set to 0 since this is a synchronization semaphore */
   sup->sup_privateSem = 0;
 
-  /* Determine RAMTOP */
-  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
-  memaddr RAMTOP = RAMSTART + busRegArea->ramsize;
-
-  /* Avoiding the last frame: Reserve the last frame below RAMTOP for the test
-   * process */
-  memaddr SUPPORT_STACK_BASE = RAMTOP - (asid * PAGESIZE * 2);
-
   /* TLB exception context */
   context_t *excCtxTLB = &sup->sup_exceptContext[PGFAULTEXCEPT];
   excCtxTLB->c_pc = (memaddr)uTLB_ExceptionHandler;
   excCtxTLB->c_status = STATUS_IEP | STATUS_IM_ALL_ON | STATUS_TE;
-  excCtxTLB->c_stackPtr = SUPPORT_STACK_BASE;
+  excCtxTLB->c_stackPtr = sup->sup_stack[PGFAULTEXCEPT];
 
   /* General exception context */
   context_t *excCtxGen = &sup->sup_exceptContext[GENERALEXCEPT];
   excCtxGen->c_pc = (memaddr)supportExceptionHandler;
   excCtxGen->c_status = STATUS_IEP | STATUS_IM_ALL_ON | STATUS_TE;
-  excCtxGen->c_stackPtr = SUPPORT_STACK_BASE - PAGESIZE;
+  excCtxGen->c_stackPtr = sup->sup_stack[GENERALEXCEPT];
 
   initPageTable(sup, asid);
 }
 
 /**
- * @brief Copy each U-proc's logical image from its flash device to the global
- * backing store disk (DISK0).
+ * @brief Image helper process: prepare the backing store for the logical image
+ * on one flash device, then report it ready and terminate.
+ *
+ * The image is not copied to the global backing store disk (DISK0): the Pager
+ * faults pages in straight from the flash device, and a page reaches DISK0
+ * only when it is evicted after being written to. The helper:
+ *   1. Reads block 0 into the device's DMA buffer to extract the U-proc
+ *      header, obtaining the .text and .data sizes.
+ *   2. Computes the number of 4KB pages containing code+data.
+ *   3. Records the flash as ready (or the error) for init(), which hands the
+ *      size to the Pager for every U-proc running the image.
  *
- * For each flash device (0-7):
- *   1. Read block 0 into the device's DMA buffer to extract the U-proc header,
- *      obtaining the .text and .data sizes.
- *   2. Compute the number of 4KB pages containing code+data.
- *   3. For each block up to that count:
- *        - Read the block into the DMA buffer.
- *        - Write the buffer to DISK0 at correct sector.
- *   4. On any error, terminate the current process (SYS9).
+ * @param flashNum Flash device number (0-7).
  */
-HIDDEN void initBackingStore() {
-  /* Copy each U-proc's execution image from its flash device to DISK0 */
-  int flashNum;
-  for (flashNum = 0; flashNum < DEVPERINT; flashNum++) {
-    /* Compute physical DMA buffer address for this flash */
-    memaddr dmaBuf = FLASH_DMA_BASE + flashNum * PAGESIZE;
-
-    /* Read the first block of each flash device to examine the U-proc's header
-     * information */
-    if (flashOperation(flashNum, 0, dmaBuf, FLASH_READBLK) < 0) {
-      SYSCALL(TERMINATEPROCESS, 0, 0, 0);
-    }
+HIDDEN void imageHelper(int flashNum) {
+  /* Read the first block of the flash device to examine the U-proc's header
+   * information, into the device's DMA buffer. Only the pages containing the
+   * .text and .data sections are read from the flash device; the remainder of
+   * the U-proc's logical address space is uninitialized and starts out
+   * zeroed */
+  int numPages =
+      readImagePages(flashNum, FLASH_DMA_BASE + flashNum * PAGESIZE);
+  if (numPages < 0) {
+    imageError = TRUE;
+  } else {
+    imagePages[flashNum] = numPages;
+  }
 
-    /* Extract the .text and .data file sizes from the header */
-    int textFileSize = *(int *)(dmaBuf + TEXT_FILE_SIZE_OFFSET);
-    int dataFileSize = *(int *)(dmaBuf + DATA_FILE_SIZE_OFFSET);
+  /* Report and terminate without being preempted: the helper runs on the
+   * Support Level stack of the first U-proc bound to the flash, which is free
+   * until that U-proc is launched */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  imageReadyFlash[imageReadyCount++] = flashNum;
+  SYSCALL(VERHOGEN, (int)&imageReadySem, 0, 0);
+  SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+}
 
-    /* Compute the number of pages containing the .text and .data sections */
-    int numPages = (textFileSize + dataFileSize) / PAGESIZE;
+/**
+ * @brief Prepare the backing store for each U-proc's logical image.
+ *
+ * Launches one image helper per flash device in use, so that the devices are
+ * read concurrently while init() carries on with the rest of the setup.
+ * init() launches the U-procs bound to a flash device as soon as its helper
+ * reports.
+ *
+ * @return Number of flash devices in use (helpers launched).
+ */
+HIDDEN int initBackingStore() {
+  imageReadySem = 0;
+  imageReadyCount = 0;
+  imageError = FALSE;
+
+  int numFlash = 0;
+  int inUse = 0; /* Bit map of the flash devices with a helper */
+  int idx;
+  for (idx = 0; idx < numUProcs; idx++) {
+    int flashNum = uProcSupport[idx]->sup_dev.b_flash;
+    if (inUse & DEV_BIT(flashNum)) {
+      continue;
+    }
+    inUse |= DEV_BIT(flashNum);
+    numFlash++;
+
+    /* Kernel mode, interrupts and timers enabled, kernel ASID (0), flash
+     * number as its argument */
+    state_t helperState;
+    helperState.s_pc = helperState.s_t9 = (memaddr)imageHelper;
+    helperState.s_sp = uProcSupport[idx]->sup_stack[PGFAULTEXCEPT];
+    helperState.s_a0 = flashNum;
+    helperState.s_status = STATUS_IEP | STATUS_IM_ALL_ON | STATUS_TE;
+    helperState.s_entryHI = (0 << ASID_SHIFT);
+
+    if (SYSCALL(CREATEPROCESS, (int)&helperState, (int)NULL, 0) != OK) {
+      SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+    }
+  }
 
-    /* Only copy the blocks containing the U-proc's .text and .data. The
-     * remainder of the U-proc's logical address space is uninitialized and need
-     * not be (unnecessarily) copied from the flash device to DISK0 */
-    int blockNum;
-    for (blockNum = 0; blockNum < numPages; blockNum++) {
-      if (flashOperation(flashNum, blockNum, dmaBuf, FLASH_READBLK) < 0) {
-        SYSCALL(TERMINATEPROCESS, 0, 0, 0);
-      }
+  return numFlash;
+}
 
-      int sectorNum = flashNum * MAXPAGES + blockNum;
-      if (diskOperation(BACKING_DISK, sectorNum, dmaBuf, DISK_WRITEBLK) < 0) {
-        SYSCALL(TERMINATEPROCESS, 0, 0, 0);
-      }
-    }
+/**
+ * @brief Launch a U-proc whose support structure has been initialized, with
+ * the U-proc CPU quota.
+ *
+ * @param sup Support structure of the U-proc.
+ */
+HIDDEN void launchUProc(support_t *sup) {
+  initBackingPages(sup, imagePages[sup->sup_dev.b_flash]);
+
+  state_t uProcState;
+  initUProcState(&uProcState, sup->sup_asid);
+  int status = SYSCALL(CREATEQUOTA, (int)&uProcState, (int)sup,
+                       (int)&uProcQuota);
+  if (status != OK) {
+    /* Error creating u-procs, terminate the current process */
+    SYSCALL(TERMINATEPROCESS, 0, 0, 0);
   }
 }
 
@@ -172,14 +249,18 @@ HIDDEN void initGlobalPageTable() {
  * @brief Support Level instantiator process (Phase 3 entry point).
  *
  * Performs global support-level setup and launches user processes (U-procs):
- * - Initializes the swap pool and support-level device semaphores.
- * - Sets up the support structure free list.
- * - Sets up the backing store.
- * - For each U-proc (ASID 1 to MAX_UPROCS):
- *     - Initializes its processor state and support structure.
- *     - Calls CREATEPROCESS to launch the U-proc.
- *     - Terminates if any error occurs during setup.
- * - Waits for all U-procs to terminate by PASSEREN on a master semaphore.
+ * - Initializes the swap pool, sized by the RAM, and the support-level device
+ *   semaphores.
+ * - Sets up the support structure free list, with as many structures as the
+ *   backing store has room for, and the daemons.
+ * - Allocates and initializes a support structure for each U-proc in the
+ *   device binding table whose flash device is installed, stopping early when
+ *   no structure or RAM is left.
+ * - Sets up the backing store, with one helper process per flash device.
+ * - Launches the U-procs bound to each flash device as soon as its image is
+ *   ready. Terminates if any error occurs during setup.
+ * - Waits for all U-procs to terminate by PASSEREN on a master semaphore,
+ *   which the last one to terminate signals.
  * - Terminates itself via TERMINATEPROCESS, triggering HALT.
  *
  * Note: Called by the initial test process during Nucleus startup.
@@ -188,7 +269,11 @@ void init() {
   int i;
 
   /* Initialize the Swap Pool table and Swap Pool semaphore */
-  initSwapStructs();
+  int maxAddrSpaces = initSwapStructs();
+  if (maxAddrSpaces == 0) {
+    /* Error: not enough RAM or backing store for a U-proc */
+    SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+  }
 
   /* Initialize support level device semaphores to 1 since they will be used for
    * mutual exclusion */
@@ -196,16 +281,44 @@ void init() {
     supportDeviceSem[i] = 1;
   }
 
-  /* Initialize the free list of Support Structures */
-  initSupportFreeList();
+  /* Hand out RAM pages for the support level daemons and U-procs */
+  initStackAlloc(swapPoolEnd());
 
-  /* Initialize the backing store (DISK0) by copying U-proc's execution images
-   * from flash devices */
-  initBackingStore();
+  /* Initialize the free list of Support Structures */
+  initSupportFreeList(maxAddrSpaces);
 
   /* Initialize the Active Delay List for the Delay Facility */
   initADL();
 
+  /* Initialize the print spool and launch one daemon per installed printer */
+  initSpooler();
+
+  /* Prepare as many U-procs as the support structures and RAM allow, leaving
+   * out those bound to a flash device that is not installed */
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+  unsigned int flashInstalled = busRegArea->inst_dev[FLASHINT - DISKINT];
+  numUProcs = 0;
+  support_t *sup;
+  for (i = 0; i < NUM_BINDINGS && numUProcs < MAX_UPROCS; i++) {
+    if (!(flashInstalled & DEV_BIT(uProcBinding[i].b_flash))) {
+      continue;
+    }
+    if ((sup = supportAlloc()) == NULL) {
+      break;
+    }
+    initSupportStruct(sup); /* ASIDs are handed out from 1 up */
+    sup->sup_dev = uProcBinding[i];
+    uProcSupport[numUProcs++] = sup;
+  }
+  if (numUProcs == 0) {
+    /* Error: no support structure available */
+    SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+  }
+
+  /* Initialize the backing store: helpers read the U-procs' image headers
+   * from the flash devices in the background */
+  int numFlash = initBackingStore();
+
   /* Initialize the global page table for the logical address space shared
    * between U-procs  */
   initGlobalPageTable();
@@ -214,29 +327,35 @@ void init() {
    * space between U-procs */
   initALSL();
 
-  /* Launch U-procs */
-  int asid;
-  for (asid = 1; asid <= MAX_UPROCS; asid++) {
-    state_t uProcState;
-    initUProcState(&uProcState, asid);
-    support_t *sup = supportAlloc();
-    if (sup == NULL) {
-      /* Error: no support structure available */
+  /* Initialize the kernel pipes used for bulk transfers between U-procs */
+  initPipes();
+
+  /* Initialize the thread table for SYS30/SYS31 */
+  initThreads();
+
+  /* Must be ready before the first U-proc can terminate */
+  masterSemaphore = 0;
+  liveUProcs = numUProcs;
+
+  /* Launch U-procs, those of each image as soon as it is ready */
+  for (i = 0; i < numFlash; i++) {
+    SYSCALL(PASSEREN, (int)&imageReadySem, 0, 0);
+    if (imageError) {
+      /* Error: a flash device could not be read */
       SYSCALL(TERMINATEPROCESS, 0, 0, 0);
     }
-    initSupportStruct(sup, asid);
-    int status = SYSCALL(CREATEPROCESS, (int)&uProcState, (int)sup, 0);
-    if (status != OK) {
-      /* Error creating u-procs, terminate the current process */
-      SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+
+    int idx;
+    for (idx = 0; idx < numUProcs; idx++) {
+      if (uProcSupport[idx]->sup_dev.b_flash == imageReadyFlash[i]) {
+        launchUProc(uProcSupport[idx]);
+      }
     }
   }
 
-  /* Wait for all U-procs to terminate */
-  masterSemaphore = 0;
-  for (i = 0; i < MAX_UPROCS; i++) {
-    SYSCALL(PASSEREN, (int)&masterSemaphore, 0, 0);
-  }
+  /* Wait for all U-procs, including forked ones, to terminate. The last one
+   * to terminate signals the master semaphore */
+  SYSCALL(PASSEREN, (int)&masterSemaphore, 0, 0);
 
   /* All U-procs done—terminate gracefully */
   SYSCALL(TERMINATEPROCESS, 0, 0, 0); /* Triggers HALT */
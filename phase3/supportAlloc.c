@@ -5,7 +5,16 @@
  * Support Level. A free-list is maintained as a stack (array of pointers) to
  * support_t structures. This module provides routines to allocate a support
  * structure from the free list, return one to the free list, and initialize the
- * free list with a statically allocated array.
+ * free list with a statically allocated array of up to MAX_UPROCS structures.
+ * It also hands out RAM pages to be used as stacks by Support Level daemon
+ * processes and as the U-procs' Support Level stacks and private DMA buffers.
+ * A support structure gets its pages the first time it is allocated and keeps
+ * them when it is reused, so the number of U-procs is bounded by the RAM left
+ * above the Swap Pool as well as by MAX_UPROCS and the size of the backing
+ * store. Each structure also owns an ASID, so a U-proc gets a free ASID with
+ * its support structure; structures are handed out in ASID order at first. (A
+ * thread's structure runs with the ASID of its U-proc instead, until it is
+ * allocated again.)
  * @date 2025-04-17
  *
  * @copyright Copyright (c) 2025
@@ -14,26 +23,61 @@
 
 #include "../h/supportAlloc.h"
 
+#include "umps3/umps/libumps.h"
+
+/* Storage for U-procs' support structures. Structure i owns ASID i + 1 */
+HIDDEN support_t supportPool[MAX_UPROCS];
+
 /* Stack of available support_t structures (used as a free list). */
 HIDDEN support_t *supportFreeList[MAX_UPROCS];
 
 /* Index of the top of the supportFreeList stack. -1 indicates empty. */
 HIDDEN int supportFreeListTop;
 
+/* Top address of the next RAM page to hand out. Pages are taken downwards,
+ * starting just below the pages reserved for init() and the Delay Daemon,
+ * down to pageFloor. */
+HIDDEN memaddr nextPageTop;
+HIDDEN memaddr pageFloor;
+
 /**
  * @brief Allocate a support_t structure from the free list.
  *
  * Implements a stack-based allocator. Returns the top support structure
- * from the free list and updates the stack index.
+ * from the free list and updates the stack index, with the structure's ASID
+ * set. A structure that has never been used first gets its two Support Level
+ * stack pages and its DMA page.
+ *
+ * Interrupts are disabled meanwhile, since U-procs fork and terminate
+ * concurrently.
  *
  * @return Pointer to a support_t structure if available; NULL if the free list
- * is empty.
+ * is empty or no RAM is left for its pages.
  */
 support_t *supportAlloc() {
-  if (supportFreeListTop < 0) {
-    return NULL;
+  support_t *sup = NULL;
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+
+  if (supportFreeListTop >= 0) {
+    sup = supportFreeList[supportFreeListTop];
+    if (sup->sup_dmaBuf == 0) {
+      if (nextPageTop - SUPPORT_PAGES * PAGESIZE < pageFloor) {
+        sup = NULL;
+      } else {
+        sup->sup_stack[PGFAULTEXCEPT] = stackAlloc();
+        sup->sup_stack[GENERALEXCEPT] = stackAlloc();
+        sup->sup_dmaBuf = pageAlloc();
+      }
+    }
+    if (sup != NULL) {
+      sup->sup_asid = (sup - supportPool) + 1;
+      supportFreeListTop--;
+    }
   }
-  return supportFreeList[supportFreeListTop--];
+
+  setSTATUS(status); /* Reenable interrupts */
+  return sup;
 }
 
 /**
@@ -44,23 +88,70 @@ support_t *supportAlloc() {
  * @param sup Pointer to the support_t structure to deallocate.
  */
 void supportDeallocate(support_t *sup) {
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
   supportFreeList[++supportFreeListTop] = sup;
+  setSTATUS(status); /* Reenable interrupts */
 }
 
 /**
  * @brief Initialize the support_t structure free list.
  *
- * Prepares a statically allocated array of support_t structures and populates
- * the stack-based free list with them. Called once at system startup by the
- * Support Level.
+ * Populates the stack-based free list with the first numStructs statically
+ * allocated support_t structures, so that the one owning ASID 1 is on top.
+ * Called once at system startup by the Support Level.
+ *
+ * @param numStructs Number of structures to use (at most MAX_UPROCS), which
+ * also bounds the ASIDs handed out.
  */
-void initSupportFreeList() {
-  /* Storage for U-procs' support structures */
-  static support_t uProcSupport[MAX_UPROCS];
+void initSupportFreeList(int numStructs) {
   supportFreeListTop = -1;
 
   int i;
-  for (i = 0; i < MAX_UPROCS; i++) {
-    supportDeallocate(&uProcSupport[i]);
+  for (i = numStructs - 1; i >= 0; i--) {
+    supportPool[i].sup_dmaBuf = 0; /* No pages yet */
+    supportDeallocate(&supportPool[i]);
+  }
+}
+
+/**
+ * @brief Initialize the RAM page allocator.
+ *
+ * Called once at system startup by the Support Level.
+ *
+ * @param bottom Lowest address the pages may use (the end of the Swap Pool).
+ */
+void initStackAlloc(memaddr bottom) {
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+  memaddr RAMTOP = RAMSTART + busRegArea->ramsize;
+  nextPageTop = RAMTOP - RESERVED_STACK_PAGES * PAGESIZE;
+  pageFloor = bottom;
+}
+
+/**
+ * @brief Allocate a RAM page for the Support Level.
+ *
+ * Pages are never returned, since their users live as long as the system.
+ *
+ * @return The base address of the page, or 0 if the page would overlap the
+ * Swap Pool.
+ */
+memaddr pageAlloc() {
+  if (nextPageTop - PAGESIZE < pageFloor) {
+    return 0;
   }
+
+  nextPageTop -= PAGESIZE;
+  return nextPageTop;
+}
+
+/**
+ * @brief Allocate a one-page stack for a Support Level daemon process.
+ *
+ * @return The initial stack pointer (top of the page), or 0 if no page is
+ * left.
+ */
+memaddr stackAlloc() {
+  memaddr page = pageAlloc();
+  return (page == 0) ? 0 : page + PAGESIZE;
 }
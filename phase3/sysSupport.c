@@ -19,10 +19,14 @@
 #include "../h/delayDaemon.h"
 #include "../h/deviceSupportChar.h"
 #include "../h/deviceSupportDMA.h"
+#include "../h/exceptions.h"
 #include "../h/initProc.h"
 #include "../h/initial.h"
+#include "../h/pipe.h"
+#include "../h/printSpooler.h"
 #include "../h/scheduler.h"
 #include "../h/supportAlloc.h"
+#include "../h/thread.h"
 #include "../h/types.h"
 #include "../h/vmSupport.h"
 #include "umps3/umps/libumps.h"
@@ -52,24 +56,57 @@ void supportExceptionHandler() {
 }
 
 /**
- * @brief Terminate the current U-proc and release all its resources.
+ * @brief Terminate the current U-proc thread, and the U-proc with its last
+ * thread, releasing all its resources.
  *
- * - Acquires the swap pool mutex.
- * - Frees all physical frames allocated to the process (based on ASID).
- * - Signals the test process via the master semaphore.
- * - Returns the support structure to the free list.
+ * - Records the thread's termination, waking a thread joining it.
+ * - If other threads of the U-proc are running, returns the thread's support
+ *   structure to the free list unless it owns the address space, and ends the
+ *   thread.
+ * - Otherwise frees all physical frames allocated to the U-proc (based on
+ *   ASID), acquiring the swap pool mutex.
+ * - Waits for the process's spooled print jobs to be printed and for its
+ *   buffered terminal output to be transmitted.
+ * - Signals the test process via the master semaphore if it is the last
+ *   U-proc.
+ * - Returns the support structures of the thread and of the address space's
+ *   owner to the free list.
  * - Invokes TERMINATEPROCESS syscall to kill the process.
  *
- * @param sup Pointer to the support structure of the U-proc to be terminated.
+ * @param sup Pointer to the support structure of the thread to be terminated.
  */
 HIDDEN void sysTerminate(support_t *sup) {
+  support_t *owner = addrSpaceOwner(sup->sup_asid);
+
+  if (threadExit(sup) > 0) {
+    /* The other threads go on in the U-proc's address space */
+    if (sup != owner) {
+      supportDeallocate(sup);
+    }
+    SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+  }
+
   /* Free frames occupied by this U-proc */
   releaseFrames(sup->sup_asid);
 
-  /* Signal termination to test */
-  SYSCALL(VERHOGEN, (int)&masterSemaphore, 0, 0);
+  /* Let the printer daemon finish this U-proc's spooled output */
+  spoolFlush(sup->sup_asid - 1);
+
+  /* ... and the terminal send what is still in its transmit ring */
+  termFlush(sup);
+
+  /* Signal termination to test once no U-proc is left */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  if (--liveUProcs == 0) {
+    SYSCALL(VERHOGEN, (int)&masterSemaphore, 0, 0);
+  }
+  setSTATUS(status); /* Reenable interrupts */
 
-  /* Return the support structure to the free list */
+  /* Return the support structures to the free list */
+  if (sup != owner) {
+    supportDeallocate(owner);
+  }
   supportDeallocate(sup);
 
   /* Terminate the process */
@@ -89,6 +126,102 @@ HIDDEN void sysGetTOD(state_t *excState) {
   switchContext(excState);
 }
 
+/**
+ * @brief Implement EXEC syscall for U-procs: replace the U-proc's image with
+ * the one on another flash device, keeping its ASID and support structure.
+ *
+ * - a1: flash device number (0-7) holding the new image.
+ *
+ * Only the new image's header is read. The U-proc's frames are released and
+ * its Page Table is invalidated, so the new image is faulted in page by page
+ * as it runs, from its entry point (UPROC_PC) with a fresh stack. On success
+ * the call does not return; if the flash device is not installed or cannot be
+ * read, `s_v0` is ERR or the negated device status and the old image goes on.
+ * Only a U-proc with a single thread, the one that owns its address space,
+ * may replace its image.
+ *
+ * @param excState Pointer to the saved exception state of the current U-proc.
+ * @param sup Pointer to the support structure of the current U-proc.
+ */
+HIDDEN void sysExec(state_t *excState, support_t *sup) {
+  /* if flashNum < 0, then flashNum will be a very large number */
+  unsigned int flashNum = excState->s_a1;
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+
+  if (flashNum >= DEVPERINT ||
+      !(busRegArea->inst_dev[FLASHINT - DISKINT] & DEV_BIT(flashNum)) ||
+      threadCount(sup->sup_asid) != 1 ||
+      addrSpaceOwner(sup->sup_asid) != sup) {
+    excState->s_v0 = ERR;
+    switchContext(excState);
+  }
+
+  int numPages = readImagePages(flashNum, sup->sup_dmaBuf);
+  if (numPages < 0) {
+    excState->s_v0 = numPages;
+    switchContext(excState);
+  }
+
+  /* The old image is gone from here on */
+  sup->sup_dev.b_flash = flashNum;
+  resetAddressSpace(sup, numPages);
+
+  initUProcState(excState, sup->sup_asid);
+  switchContext(excState);
+}
+
+/**
+ * @brief Implement FORK syscall for U-procs: create a child U-proc running a
+ * copy of the caller's address space.
+ *
+ * The child gets a support structure with a free ASID, is bound to the
+ * caller's devices and shares its pages copy-on-write (see
+ * forkAddressSpace()). It resumes from the same state as the caller, after
+ * the SYSCALL. Only the calling thread is copied.
+ *
+ * `s_v0` is the child's ASID in the caller and 0 in the child, or ERR in the
+ * caller if no support structure or process is available.
+ *
+ * @param excState Pointer to the saved exception state of the current U-proc.
+ * @param sup Pointer to the support structure of the current U-proc.
+ */
+HIDDEN void sysFork(state_t *excState, support_t *sup) {
+  support_t *child = supportAlloc();
+  if (child == NULL) {
+    excState->s_v0 = ERR;
+    switchContext(excState);
+  }
+
+  initSupportStruct(child);
+  child->sup_dev = sup->sup_dev;
+  forkAddressSpace(sup, child);
+
+  state_t childState;
+  copyState(&childState, excState);
+  childState.s_v0 = 0;
+  childState.s_entryHI = child->sup_asid << ASID_SHIFT;
+
+  /* Count the child before it can terminate */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  liveUProcs++;
+  setSTATUS(status); /* Reenable interrupts */
+
+  if (SYSCALL(CREATEPROCESS, (int)&childState, (int)child, CREATE_SIBLING) !=
+      OK) {
+    setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+    liveUProcs--;
+    setSTATUS(status); /* Reenable interrupts */
+
+    releaseFrames(child->sup_asid);
+    supportDeallocate(child);
+    excState->s_v0 = ERR;
+  } else {
+    excState->s_v0 = child->sup_asid;
+  }
+  switchContext(excState);
+}
+
 /**
  * @brief Dispatch SYSCALL exceptions (syscalls 9–13 and I/O) for U-procs.
  *
@@ -104,7 +237,7 @@ HIDDEN void syscallHandler(support_t *sup) {
   state_t *excState = &sup->sup_exceptState[GENERALEXCEPT];
   int syscallNum = excState->s_a0;
 
-  if (syscallNum >= TERMINATE && syscallNum <= VSEMLOGICAL) {
+  if (syscallNum >= TERMINATE && syscallNum <= THREADJOIN) {
     excState->s_pc += WORDLEN; /* control of the current process should be
                                   returned to the next instruction */
     switch (syscallNum) {
@@ -144,6 +277,39 @@ HIDDEN void syscallHandler(support_t *sup) {
       case VSEMLOGICAL:
         sysVerhogenLogicalSem(excState, sup);
         break;
+      case PRINTFLUSH:
+        sysPrintFlush(excState, sup);
+        break;
+      case PRINTSTATS:
+        sysPrintStats(excState, sup);
+        break;
+      case VSEMLOGICALALL:
+        sysVerhogenAllLogicalSem(excState, sup);
+        break;
+      case BARRIERLOGICAL:
+        sysBarrierLogical(excState, sup);
+        break;
+      case PIPESEND:
+        sysPipeSend(excState, sup);
+        break;
+      case PIPERECV:
+        sysPipeReceive(excState, sup);
+        break;
+      case DELAYUS:
+        sysDelayMicro(excState, sup);
+        break;
+      case EXEC:
+        sysExec(excState, sup);
+        break;
+      case FORK:
+        sysFork(excState, sup);
+        break;
+      case THREADCREATE:
+        sysThreadCreate(excState, sup);
+        break;
+      case THREADJOIN:
+        sysThreadJoin(excState, sup);
+        break;
       default:
         break;
     }
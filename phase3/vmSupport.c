@@ -5,6 +5,31 @@
  * including the TLB exception handler (Pager) and the functions for reading
  * from and writing to flash devices. This module also manages the Swap Pool
  * data structures used for paging.
+ *
+ * The backing store is filled lazily. A private page that has never been
+ * written to DISK0 is faulted in straight from the U-proc's flash device (or
+ * zero-filled if it lies outside the .text/.data image). Pages are mapped
+ * read-only until their first write, which the Pager records by setting the
+ * Dirty bit, and only dirty pages are written to DISK0 when evicted.
+ *
+ * A forked U-proc shares its parent's pages copy-on-write. Resident frames are
+ * mapped read-only by both, and the first write to a frame with several
+ * mappers gives the writer a private copy. DISK0 sectors are reference counted
+ * as well: a page that is not resident reads the sector its parent wrote, and
+ * gets a sector of its own only when it is written back after a change.
+ *
+ * The threads of a U-proc (SYS30) run with its ASID and share the Page Table
+ * of the support structure that owns the address space.
+ *
+ * The Swap Pool is sized by the RAM of the machine: two frames for each U-proc
+ * whose Support Level pages fit in the rest of RAM, up to SWAP_POOL_MAX. DISK0
+ * holds the private pages of as many address spaces as it has room for,
+ * followed by the pages of the shared segment.
+ *
+ * U-procs may run on several processors, each with its own TLB, while these
+ * routines run on processor 0. Whenever a Page Table entry loses its frame or
+ * its write access, every other processor flushes its TLB (tlbShootdown())
+ * before the frame is reused or shared.
  * @date 2025-04-17
  *
  * @copyright Copyright (c) 2025
@@ -19,64 +44,380 @@
 #include "../h/initProc.h"
 #include "../h/initial.h"
 #include "../h/scheduler.h"
+#include "../h/smp.h"
 #include "../h/sysSupport.h"
 #include "../h/types.h"
 #include "umps3/umps/libumps.h"
 
 /* Module-wide variables */
-HIDDEN memaddr swapPool; /* RAM frames set aside to support virtual memory */
-spte_t swapPoolTable[SWAP_POOL_SIZE]; /* Swap Pool table */
-int swapPoolSem;                      /* Swap Pool semaphore: mutex */
+HIDDEN memaddr swapPool;  /* RAM frames set aside to support virtual memory */
+HIDDEN int swapPoolSize;  /* Number of frames in the Swap Pool */
+spte_t swapPoolTable[SWAP_POOL_MAX]; /* Swap Pool table */
+int swapPoolSem;                     /* Swap Pool semaphore: mutex */
+
+/* Backing store state of each U-proc's address space, indexed by ASID */
+HIDDEN support_t *addrSpace[MAX_UPROCS + 1]; /* Owner, NULL if ASID unused */
+HIDDEN int imagePages[MAX_UPROCS + 1]; /* .text/.data pages on the flash */
+HIDDEN int pageSector[MAX_UPROCS + 1][MAXPAGES]; /* DISK0 copy or NO_SECTOR */
+
+/* Number of private pages backed by each DISK0 sector (0 if free) */
+HIDDEN int sectorRefs[BACKING_SECTORS_MAX];
+HIDDEN int sharedBaseSector; /* DISK0 sector of the first shared page */
+
+HIDDEN int vpnToPageIndex(unsigned int vpn);
+HIDDEN int allocSector();
 
 /**
  * @brief Initialize the Swap Pool data structures.
  *
- * - Sets the base address for swap pool frames.
+ * - Sets the base address for swap pool frames and sizes the pool by the RAM
+ *   size.
+ * - Lays out the backing store on DISK0 according to its geometry.
  * - Marks all entries in the swap pool table as unoccupied.
  * - Initializes the swap pool semaphore to 1 (for mutual exclusion).
+ *
+ * @return Number of address spaces (ASIDs 1 and up) the backing store can
+ * hold, or 0 if the RAM or DISK0 is too small for a single U-proc.
  */
-void initSwapStructs() {
-  /* Place the Swap Pool after the end of the operating system code */
+int initSwapStructs() {
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+
+  /* Place the Swap Pool after the end of the operating system code, leaving
+   * the RAM above it to the Support Level pages of the U-procs and the
+   * printer daemons' stacks */
   swapPool = SWAP_POOL_BASE;
+  memaddr RAMTOP = RAMSTART + busRegArea->ramsize;
+  int frames = (int)(RAMTOP - SWAP_POOL_BASE) / PAGESIZE -
+               RESERVED_STACK_PAGES - DEVPERINT;
+  swapPoolSize = (frames > 0) ? 2 * (frames / (2 + SUPPORT_PAGES)) : 0;
+  if (swapPoolSize > SWAP_POOL_MAX) {
+    swapPoolSize = SWAP_POOL_MAX;
+  }
+
+  /* Fit as many address spaces on DISK0 as possible before the shared
+   * pages */
+  unsigned int data1 = busRegArea->devreg[BACKING_DISK].d_data1;
+  int sectors = GET_DISK_CYLINDER(data1) * GET_DISK_HEAD(data1) *
+                GET_DISK_SECTOR(data1);
+  int addrSpaces = (sectors - KUSEGSHARE_PAGES) / MAXPAGES;
+  if (addrSpaces > MAX_UPROCS) {
+    addrSpaces = MAX_UPROCS;
+  } else if (addrSpaces < 0) {
+    addrSpaces = 0;
+  }
+  sharedBaseSector = addrSpaces * MAXPAGES;
 
   int i;
   /* Initialize Swap Pool table entries */
-  for (i = 0; i < SWAP_POOL_SIZE; i++) {
+  for (i = 0; i < swapPoolSize; i++) {
     swapPoolTable[i].spte_asid = ASID_UNOCCUPIED; /* Invalid ASID */
     swapPoolTable[i].spte_vpn = 0;
     swapPoolTable[i].spte_pte = NULL;
+    swapPoolTable[i].spte_refs = 0;
+    swapPoolTable[i].spte_dirty = FALSE;
+  }
+
+  /* No private page is on DISK0 yet */
+  for (i = 0; i < sharedBaseSector; i++) {
+    sectorRefs[i] = 0;
+  }
+  for (i = 0; i <= MAX_UPROCS; i++) {
+    addrSpace[i] = NULL;
   }
 
   /* Initialize Swap Pool semaphore to 1, providing mutual exclusion for the
    * swapPoolTable */
   swapPoolSem = 1;
+
+  return (swapPoolSize > 0) ? addrSpaces : 0;
 }
 
 /**
- * @brief Free all swap pool frames owned by the given U-proc.
+ * @brief Get the end of the Swap Pool, above which the Support Level may
+ * allocate RAM pages.
  *
- * Iterates through the swap pool table and invalidates any frame associated
- * with the given ASID. Ensures mutual exclusion by acquiring and releasing the
- * swap pool semaphore.
+ * @return The address just past the last Swap Pool frame.
+ */
+memaddr swapPoolEnd() { return swapPool + swapPoolSize * PAGESIZE; }
+
+/**
+ * @brief Get the support structure owning an address space, whose Page Table
+ * all threads of the U-proc use.
+ *
+ * @param asid The Address Space Identifier (ASID) of the U-proc.
+ * @return The owner's support structure, or NULL if the ASID is unused.
+ */
+support_t *addrSpaceOwner(int asid) { return addrSpace[asid]; }
+
+/**
+ * @brief Get the Page Table of the address space a U-proc thread runs in.
+ *
+ * @param sup Support structure of the thread.
+ * @return The private Page Table of the U-proc.
+ */
+HIDDEN pte_t *pageTable(support_t *sup) {
+  return addrSpace[sup->sup_asid]->sup_privatePgTbl;
+}
+
+/**
+ * @brief Get the index of the swap pool frame a valid Page Table entry maps.
+ *
+ * @param pte Valid Page Table entry.
+ * @return Index of the frame within the swap pool.
+ */
+HIDDEN int frameOf(pte_t *pte) {
+  return ((pte->pte_entryLO & PFN_MASK) - swapPool) / PAGESIZE;
+}
+
+/**
+ * @brief Find the U-procs whose Page Tables map a private swap pool frame.
+ *
+ * @param frameIdx Index of the frame within the swap pool.
+ * @param asids Array of MAX_UPROCS entries, filled with the mappers' ASIDs.
+ * @return Number of mappers found.
+ */
+HIDDEN int findMappers(int frameIdx, int asids[]) {
+  memaddr frameAddr = swapPool + (frameIdx * PAGESIZE);
+  int pageIdx = vpnToPageIndex(swapPoolTable[frameIdx].spte_vpn);
+  int count = 0;
+
+  int asid;
+  for (asid = 1; asid <= MAX_UPROCS; asid++) {
+    if (addrSpace[asid] != NULL) {
+      unsigned int entryLO =
+          addrSpace[asid]->sup_privatePgTbl[pageIdx].pte_entryLO;
+      if ((entryLO & PTE_VALID) && (entryLO & PFN_MASK) == frameAddr) {
+        asids[count++] = asid;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Remove one U-proc from the mappers of a private swap pool frame,
+ * after its Page Table entry has stopped mapping the frame. The frame is freed
+ * with its last mapper. The caller holds the Swap Pool semaphore.
+ *
+ * @param frameIdx Index of the frame within the swap pool.
+ * @param asid ASID of the U-proc.
+ */
+HIDDEN void dropMapping(int frameIdx, int asid) {
+  spte_t *spte = &swapPoolTable[frameIdx];
+
+  if (--spte->spte_refs == 0) {
+    spte->spte_asid = ASID_UNOCCUPIED;
+    spte->spte_vpn = 0;
+    spte->spte_pte = NULL;
+    spte->spte_dirty = FALSE;
+  } else if (spte->spte_asid == asid) {
+    /* The frame is recorded under one of its mappers: hand it over */
+    int asids[MAX_UPROCS];
+    findMappers(frameIdx, asids);
+    spte->spte_asid = asids[0];
+    spte->spte_pte = &addrSpace[asids[0]]->sup_privatePgTbl[vpnToPageIndex(
+        spte->spte_vpn)];
+  }
+}
+
+/**
+ * @brief Release the swap pool frames and DISK0 sectors of the given U-proc's
+ * address space. Frames and sectors it shares are freed with their last user.
+ * The caller holds the Swap Pool semaphore.
+ *
+ * @param asid The Address Space Identifier (ASID) of the U-proc.
+ */
+HIDDEN void freeFrames(int asid) {
+  support_t *sup = addrSpace[asid];
+  if (sup == NULL) {
+    return;
+  }
+
+  /* No longer a mapper of any frame */
+  addrSpace[asid] = NULL;
+
+  int i;
+  for (i = 0; i < MAXPAGES; i++) {
+    if (sup->sup_privatePgTbl[i].pte_entryLO & PTE_VALID) {
+      dropMapping(frameOf(&sup->sup_privatePgTbl[i]), asid);
+    }
+    if (pageSector[asid][i] != NO_SECTOR) {
+      sectorRefs[pageSector[asid][i]]--;
+      pageSector[asid][i] = NO_SECTOR;
+    }
+  }
+}
+
+/**
+ * @brief Free all swap pool frames and DISK0 sectors owned by the given
+ * U-proc.
+ *
+ * Frames and sectors shared with a forked parent or child stay in use by the
+ * other U-procs. Ensures mutual exclusion by acquiring and releasing the swap
+ * pool semaphore.
  *
  * @param asid The Address Space Identifier (ASID) of the process whose frames
  * are being freed.
  */
 void releaseFrames(int asid) {
   SYSCALL(PASSEREN, (int)&swapPoolSem, 0, 0);
+  freeFrames(asid);
+  SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
+}
+
+/**
+ * @brief Give a U-proc a fresh address space for a new image (SYS28): free
+ * its swap pool frames, invalidate its whole Page Table and flush the TLB, and
+ * reset its backing store state so that pages are faulted in from the flash
+ * device it is bound to.
+ *
+ * @param sup Support structure of the U-proc.
+ * @param numPages Number of .text/.data pages in the new image.
+ */
+void resetAddressSpace(support_t *sup, int numPages) {
+  SYSCALL(PASSEREN, (int)&swapPoolSem, 0, 0);
+  freeFrames(sup->sup_asid);
 
+  /* Update Page Table and TLB atomically, as the Pager does */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
   int i;
-  for (i = 0; i < SWAP_POOL_SIZE; i++) {
-    if (swapPoolTable[i].spte_asid == asid) {
-      swapPoolTable[i].spte_asid = ASID_UNOCCUPIED;
-      swapPoolTable[i].spte_vpn = 0;
-      swapPoolTable[i].spte_pte = NULL;
+  for (i = 0; i < MAXPAGES; i++) {
+    sup->sup_privatePgTbl[i].pte_entryLO = PTE_DIRTY;
+  }
+  TLBCLR();
+  setSTATUS(status); /* Reenable interrupts */
+  tlbShootdown();
+
+  initBackingPages(sup, numPages);
+  SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
+}
+
+/**
+ * @brief Give a forked U-proc (SYS29) a copy-on-write copy of its parent's
+ * address space.
+ *
+ * The child maps every frame resident for the parent, and both lose write
+ * access to them; a frame the parent had written is remembered as dirty, so
+ * that it is still written back when evicted. Pages that are not resident are
+ * read from the parent's DISK0 sectors or flash image when faulted in.
+ *
+ * @param parent Support structure of the forking U-proc (or thread).
+ * @param child Support structure of the child, with its Page Table initialized
+ * for its ASID and bound to the same flash device as the parent.
+ */
+void forkAddressSpace(support_t *parent, support_t *child) {
+  int parentAsid = parent->sup_asid;
+  int childAsid = child->sup_asid;
+
+  SYSCALL(PASSEREN, (int)&swapPoolSem, 0, 0);
+  addrSpace[childAsid] = child;
+  imagePages[childAsid] = imagePages[parentAsid];
+
+  /* Update Page Tables and TLB atomically, as the Pager does */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  int i;
+  for (i = 0; i < MAXPAGES; i++) {
+    pte_t *parentPte = &pageTable(parent)[i];
+    if (parentPte->pte_entryLO & PTE_VALID) {
+      spte_t *spte = &swapPoolTable[frameOf(parentPte)];
+      if (parentPte->pte_entryLO & PTE_DIRTY) {
+        spte->spte_dirty = TRUE;
+        parentPte->pte_entryLO &= ~PTE_DIRTY;
+      }
+      spte->spte_refs++;
+    }
+    child->sup_privatePgTbl[i].pte_entryLO = parentPte->pte_entryLO;
+
+    pageSector[childAsid][i] = pageSector[parentAsid][i];
+    if (pageSector[childAsid][i] != NO_SECTOR) {
+      sectorRefs[pageSector[childAsid][i]]++;
     }
   }
+  /* Drop the parent's writable entries, and any left by a U-proc that had the
+   * child's ASID before */
+  TLBCLR();
+  setSTATUS(status); /* Reenable interrupts */
+  tlbShootdown();
 
   SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
 }
 
+/**
+ * @brief Reset the backing store state of an address space: none of its pages
+ * is on DISK0, and the first numPages pages are read from the flash device the
+ * U-proc is bound to when first faulted in. The Pager knows the U-proc's
+ * Page Table from here on.
+ *
+ * @param sup Support structure of the U-proc.
+ * @param numPages Number of .text/.data pages in the U-proc's flash image.
+ */
+void initBackingPages(support_t *sup, int numPages) {
+  int asid = sup->sup_asid;
+  addrSpace[asid] = sup;
+  imagePages[asid] = numPages;
+
+  int i;
+  for (i = 0; i < MAXPAGES; i++) {
+    pageSector[asid][i] = NO_SECTOR;
+  }
+}
+
+/**
+ * @brief Save a flash block to DISK0 for every U-proc whose image still reads
+ * it from the flash device, before SYS16 overwrites it.
+ *
+ * The Pager faults image pages in straight from the flash device as long as
+ * they are not on DISK0, so without this a U-proc bound to the flash would
+ * later load the new contents as its code or data. The U-procs keep sharing
+ * one sector, reference counted like the sectors of a forked U-proc.
+ *
+ * @param flashNum Flash device about to be written.
+ * @param blockNum Block about to be written.
+ * @param buf Kernel page to read the block into.
+ * @return READY (1) on success, or -status on a flash or disk error.
+ */
+int saveImageBlock(int flashNum, int blockNum, memaddr buf) {
+  SYSCALL(PASSEREN, (int)&swapPoolSem, 0, 0);
+
+  /* Find the U-procs that would fault the block in from the flash device */
+  int readers[MAX_UPROCS];
+  int numReaders = 0;
+  int asid;
+  for (asid = 1; asid <= MAX_UPROCS; asid++) {
+    if (addrSpace[asid] != NULL &&
+        addrSpace[asid]->sup_dev.b_flash == flashNum &&
+        blockNum < imagePages[asid] &&
+        pageSector[asid][blockNum] == NO_SECTOR) {
+      readers[numReaders++] = asid;
+    }
+  }
+
+  int result = READY;
+  if (numReaders > 0) {
+    int devIdx = (FLASHINT - DISKINT) * DEVPERINT + flashNum;
+    SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
+    result = flashOperation(flashNum, blockNum, buf, FLASH_READBLK);
+    SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
+
+    if (result == READY) {
+      int sectorNum = allocSector();
+      result = diskOperation(BACKING_DISK, sectorNum, buf, DISK_WRITEBLK);
+      if (result == READY) {
+        sectorRefs[sectorNum] = numReaders;
+        int i;
+        for (i = 0; i < numReaders; i++) {
+          pageSector[readers[i]][blockNum] = sectorNum;
+        }
+      }
+    }
+  }
+
+  SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
+  return result;
+}
+
 /**
  * @brief Check if a virtual address lies within the U-proc's user segment
  * (KUSEG).
@@ -86,6 +427,37 @@ void releaseFrames(int asid) {
  */
 int isValidAddr(memaddr addr) { return addr >= KUSEG; }
 
+/**
+ * @brief Check that every page touched by the buffer [addr, addr + len) lies
+ * within the U-proc's user segment (KUSEG), so buffers of any length can be
+ * validated before a syscall streams through them.
+ *
+ * @param addr Virtual address of the first byte.
+ * @param len Length of the buffer in bytes (0 is always valid).
+ * @return 1 if the whole buffer is valid; 0 otherwise (including when the
+ * buffer wraps around the end of the address space).
+ */
+int isValidRange(memaddr addr, unsigned int len) {
+  if (len == 0) {
+    return TRUE;
+  }
+
+  memaddr last = addr + len - 1;
+  if (last < addr) {
+    return FALSE; /* wrapped around */
+  }
+
+  /* Check the first byte of each page, then the last byte */
+  memaddr page;
+  for (page = addr; page - addr < len;
+       page = (page & ~(PAGESIZE - 1)) + PAGESIZE) {
+    if (!isValidAddr(page)) {
+      return FALSE;
+    }
+  }
+  return isValidAddr(last);
+}
+
 /**
  * @brief Translate the virtual page number (vpn) to the page table entry's
  * index. The way this function translates depends on whether the vpn is a
@@ -98,6 +470,36 @@ HIDDEN int vpnToPageIndex(unsigned int vpn) {
   return IS_SHARED_VPN(vpn) ? (vpn - VPN_KUSEGSHARE_BASE) : (vpn % MAXPAGES);
 }
 
+/**
+ * @brief Fill a swap pool frame with a private page that is not on DISK0 yet:
+ * read it from the U-proc's flash device if it belongs to the .text/.data
+ * image, or zero it otherwise. The caller holds the Swap Pool semaphore.
+ *
+ * @param sup Support structure of the U-proc that owns the page.
+ * @param pageIdx Index of the page in the U-proc's Page Table.
+ * @param frameAddr Physical address of the frame.
+ * @return READY (1) on success, or -status on a flash error.
+ */
+HIDDEN int loadFreshPage(support_t *sup, int pageIdx, memaddr frameAddr) {
+  if (pageIdx >= imagePages[sup->sup_asid]) {
+    /* Uninitialized part of the address space */
+    int *word = (int *)frameAddr;
+    int i;
+    for (i = 0; i < PAGESIZE / WORDLEN; i++) {
+      word[i] = 0;
+    }
+    return READY;
+  }
+
+  /* Page i of the image is block i of the flash device */
+  int flashNum = sup->sup_dev.b_flash;
+  int devIdx = (FLASHINT - DISKINT) * DEVPERINT + flashNum;
+  SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
+  int result = flashOperation(flashNum, pageIdx, frameAddr, FLASH_READBLK);
+  SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
+  return result;
+}
+
 /**
  * @brief Select a frame from the swap pool to load a virtual page.
  *
@@ -114,7 +516,7 @@ HIDDEN int chooseFrame() {
   /* First search for an unoccupied frame */
   int frameIdx = 0;
   int found = FALSE;
-  while (frameIdx < SWAP_POOL_SIZE && !found) {
+  while (frameIdx < swapPoolSize && !found) {
     if (swapPoolTable[frameIdx].spte_asid == ASID_UNOCCUPIED) {
       found = TRUE;
     } else {
@@ -125,12 +527,236 @@ HIDDEN int chooseFrame() {
   /* If no free frame is found, fall back to FIFO (round-robin) */
   if (!found) {
     frameIdx = nextFrameIdx;
-    nextFrameIdx = (nextFrameIdx + 1) % SWAP_POOL_SIZE;
+    nextFrameIdx = (nextFrameIdx + 1) % swapPoolSize;
   }
 
   return frameIdx;
 }
 
+/**
+ * @brief Write a Page Table entry to the TLB entry caching it, if any. The
+ * caller has disabled interrupts.
+ *
+ * @param pte Page Table entry.
+ */
+HIDDEN void updateTLB(pte_t *pte) {
+  setENTRYHI(pte->pte_entryHI);
+  TLBP(); /* Probe TLB */
+  if (!(getINDEX() & TLB_PRESENT)) {
+    /* P=0: Match found */
+    setENTRYLO(pte->pte_entryLO);
+    TLBWI(); /* Update TLB atomically */
+  }
+}
+
+/**
+ * @brief Map a page: update its Page Table entry and the TLB atomically.
+ *
+ * @param pte Page Table entry.
+ * @param entryLO New EntryLo of the page.
+ */
+HIDDEN void mapPage(pte_t *pte, unsigned int entryLO) {
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  pte->pte_entryLO = entryLO;
+
+  setENTRYHI(pte->pte_entryHI);
+  TLBP();
+  setENTRYLO(pte->pte_entryLO);
+  if (!(getINDEX() & TLB_PRESENT)) {
+    /* P=0: Match found */
+    TLBWI();
+  } else {
+    /* P=1: No match, add new entry */
+    TLBWR(); /* Random slot */
+  }
+  setSTATUS(status); /* Reenable interrupts */
+}
+
+/**
+ * @brief Get a DISK0 sector no private page is backed by. There always is
+ * one, since every page is backed by at most one sector and only ASIDs the
+ * backing store has room for are handed out.
+ *
+ * @return Sector number.
+ */
+HIDDEN int allocSector() {
+  int sector = 0;
+  while (sectorRefs[sector] != 0) {
+    sector++;
+  }
+  return sector;
+}
+
+/**
+ * @brief Evict the page held by an occupied swap pool frame: invalidate it in
+ * the Page Table of every U-proc mapping it, and write it to DISK0 unless it is
+ * unchanged since it was loaded. The caller holds the Swap Pool semaphore.
+ *
+ * A private page written back by mappers that share their sector with pages
+ * that are not resident gets a new sector, so the others keep reading the old
+ * contents.
+ *
+ * @param frameIdx Index of the frame within the swap pool.
+ * @return READY (1) on success, or -status on a disk error.
+ */
+HIDDEN int evictFrame(int frameIdx) {
+  spte_t *spte = &swapPoolTable[frameIdx];
+  unsigned int vpn = spte->spte_vpn;
+  int pageIdx = vpnToPageIndex(vpn);
+
+  int asids[MAX_UPROCS];
+  int numMappers;
+  if (spte->spte_refs > 1) {
+    numMappers = findMappers(frameIdx, asids);
+  } else {
+    asids[0] = spte->spte_asid;
+    numMappers = 1;
+  }
+
+  /* Update the Page Tables (V=0) and the TLB atomically. The Dirty bit can
+   * no longer change once the page is invalid */
+  int dirty = spte->spte_dirty;
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  int i;
+  for (i = 0; i < numMappers; i++) {
+    pte_t *pte = (asids[i] == 0)
+                     ? spte->spte_pte
+                     : &addrSpace[asids[i]]->sup_privatePgTbl[pageIdx];
+    pte->pte_entryLO &= ~PTE_VALID;
+    dirty |= pte->pte_entryLO & PTE_DIRTY;
+    updateTLB(pte);
+  }
+  setSTATUS(status); /* Reenable interrupts */
+  tlbShootdown();
+
+  spte->spte_asid = ASID_UNOCCUPIED;
+  spte->spte_vpn = 0;
+  spte->spte_pte = NULL;
+  spte->spte_refs = 0;
+  spte->spte_dirty = FALSE;
+
+  /*
+   * Why update Page Table/TLB before writing to backing store?
+   *
+   * If we wrote to flash first, then an interrupt (e.g., another Pager) could
+   * run and see the old Page Table entry (V=1) still pointing to this frame.
+   * It might reuse or overwrite the frame before the write completes, leading
+   * to data corruption in the backing store. Updating Page Table (V=0) and
+   * TLB first ensures the frame is marked invalid and uncached, preventing
+   * access during the write. Order matters for data integrity.
+   */
+
+  if (!dirty) {
+    return READY;
+  }
+
+  int sectorNum;
+  if (IS_SHARED_VPN(vpn)) {
+    sectorNum = sharedBaseSector + pageIdx;
+  } else {
+    /* All mappers of a frame are backed by the same sector */
+    sectorNum = pageSector[asids[0]][pageIdx];
+    if (sectorNum == NO_SECTOR || sectorRefs[sectorNum] > numMappers) {
+      if (sectorNum != NO_SECTOR) {
+        sectorRefs[sectorNum] -= numMappers;
+      }
+      sectorNum = allocSector();
+      sectorRefs[sectorNum] = numMappers;
+      for (i = 0; i < numMappers; i++) {
+        pageSector[asids[i]][pageIdx] = sectorNum;
+      }
+    }
+  }
+
+  memaddr frameAddr = swapPool + (frameIdx * PAGESIZE);
+  return diskOperation(BACKING_DISK, sectorNum, frameAddr, DISK_WRITEBLK);
+}
+
+/**
+ * @brief Give a U-proc a private copy of a frame it shares copy-on-write, and
+ * map it writable. The caller holds the Swap Pool semaphore.
+ *
+ * @param sup Support structure of the writing U-proc.
+ * @param pte Its Page Table entry for the page, mapping the shared frame.
+ * @return READY (1) on success, or -status on a disk error while evicting.
+ */
+HIDDEN int copyOnWrite(support_t *sup, pte_t *pte) {
+  int srcIdx = frameOf(pte);
+  unsigned int vpn = swapPoolTable[srcIdx].spte_vpn;
+
+  int frameIdx = chooseFrame();
+  if (frameIdx == srcIdx) {
+    frameIdx = chooseFrame(); /* Keep the frame being copied */
+  }
+  if (swapPoolTable[frameIdx].spte_asid != ASID_UNOCCUPIED) {
+    int result = evictFrame(frameIdx);
+    if (result < 0) {
+      return result;
+    }
+  }
+
+  int *src = (int *)(swapPool + (srcIdx * PAGESIZE));
+  int *dst = (int *)(swapPool + (frameIdx * PAGESIZE));
+  int i;
+  for (i = 0; i < PAGESIZE / WORDLEN; i++) {
+    dst[i] = src[i];
+  }
+
+  swapPoolTable[frameIdx].spte_asid = sup->sup_asid;
+  swapPoolTable[frameIdx].spte_vpn = vpn;
+  swapPoolTable[frameIdx].spte_pte = pte;
+  swapPoolTable[frameIdx].spte_refs = 1;
+  swapPoolTable[frameIdx].spte_dirty = FALSE;
+
+  mapPage(pte, ((memaddr)dst & PFN_MASK) | PTE_DIRTY | PTE_VALID);
+  tlbShootdown(); /* Other threads of the U-proc may still map the source */
+  dropMapping(srcIdx, sup->sup_asid);
+  return READY;
+}
+
+/**
+ * @brief Handle a TLB-Modification exception: the first write to a private
+ * page mapped read-only. A page the U-proc maps alone gets its Dirty bit set
+ * in the Page Table and the TLB, so that it is written back to DISK0 when
+ * evicted; a page shared copy-on-write is copied first. The write is then
+ * retried.
+ *
+ * If the page was evicted meanwhile, the write is simply retried and faults
+ * the page in again.
+ *
+ * @param sup Support structure of the faulting U-proc.
+ * @param savedExcState Saved exception state of the faulting U-proc.
+ */
+HIDDEN void handleFirstWrite(support_t *sup, state_t *savedExcState) {
+  unsigned int vpn = (savedExcState->s_entryHI & VPN_MASK) >> VPN_SHIFT;
+  if (IS_SHARED_VPN(vpn)) {
+    /* Shared pages are always mapped writable */
+    programTrapHandler(sup);
+  }
+
+  pte_t *pte = &pageTable(sup)[vpnToPageIndex(vpn)];
+
+  SYSCALL(PASSEREN, (int)&swapPoolSem, 0, 0);
+  if (pte->pte_entryLO & PTE_VALID) {
+    if (swapPoolTable[frameOf(pte)].spte_refs == 1) {
+      /* Update Page Table and TLB atomically, as the Pager does */
+      unsigned int status = getSTATUS();
+      setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+      pte->pte_entryLO |= PTE_DIRTY;
+      updateTLB(pte);
+      setSTATUS(status); /* Reenable interrupts */
+    } else if (copyOnWrite(sup, pte) < 0) {
+      SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
+      programTrapHandler(sup); /* I/O error as trap */
+    }
+  }
+  SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
+
+  switchContext(savedExcState);
+}
+
 /**
  * @brief Handle TLB refill exception (Phase 2 version).
  *
@@ -144,7 +770,7 @@ HIDDEN int chooseFrame() {
  */
 void uTLB_RefillHandler() {
   /* Get saved exception state from BIOS Data Page */
-  state_t *savedExcState = (state_t *)BIOSDATAPAGE;
+  state_t *savedExcState = CPU_STATE(getPRID());
 
   /* Extract VPN: mask then shift */
   unsigned int entryHI = savedExcState->s_entryHI;
@@ -153,14 +779,14 @@ void uTLB_RefillHandler() {
   /* Get Page Table entry */
   support_t *sup = currentProc->p_supportStruct;
   if (sup == NULL) {
-    /* Consistent with Phase 2 behavior (pass up or die) */
-    sysTerminateProc(savedExcState);
+    /* Consistent with Phase 2 behavior (pass up or die), on processor 0 */
+    generalExceptionHandler();
   }
 
   /* Select correct page table entry (private or shared) */
   int pageIdx = vpnToPageIndex(vpn);
   pte_t *pte = IS_SHARED_VPN(vpn) ? &globalPgTbl[pageIdx]
-                                  : &sup->sup_privatePgTbl[pageIdx];
+                                  : &pageTable(sup)[pageIdx];
 
   /* Write to TLB */
   setENTRYHI(pte->pte_entryHI);
@@ -184,9 +810,9 @@ void uTLB_ExceptionHandler() {
   state_t *savedExcState = &sup->sup_exceptState[PGFAULTEXCEPT];
   unsigned int excCode = CAUSE_EXCCODE(savedExcState->s_cause);
 
-  /* 3. Check for TLB-Modification (treat as trap) */
+  /* 3. Check for TLB-Modification (first write to a clean or shared page) */
   if (excCode == EXC_TLBMOD) {
-    programTrapHandler(sup);
+    handleFirstWrite(sup, savedExcState);
   }
 
   /* 4. Lock Swap Pool */
@@ -197,10 +823,14 @@ void uTLB_ExceptionHandler() {
   /* Compute page index within either the private or shared page table */
   int pageIdx = vpnToPageIndex(vpn);
 
-  /* Another U-proc may have already loaded the shared page. If the global page
-   * table entry is now valid, there's no need to reload it.
+  /* Another U-proc may have already loaded the shared page, or another thread
+   * of this U-proc the private one. If the page table entry is now valid,
+   * there's no need to reload it; the TLB may still cache it invalid, though.
    */
-  if (IS_SHARED_VPN(vpn) && (globalPgTbl[pageIdx].pte_entryLO & PTE_VALID)) {
+  pte_t *pte = IS_SHARED_VPN(vpn) ? &globalPgTbl[pageIdx]
+                                  : &pageTable(sup)[pageIdx];
+  if (pte->pte_entryLO & PTE_VALID) {
+    mapPage(pte, pte->pte_entryLO);
     SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
     switchContext(savedExcState);
   }
@@ -208,96 +838,54 @@ void uTLB_ExceptionHandler() {
   /* 6. Pick a frame (i) */
   int frameIdx = chooseFrame();
 
-  /* 7 & 8. Check if frame i is occupied */
+  /* 7 & 8. If frame i is occupied, evict its page: invalidate it for its
+   * owners and write it to their backing store if it was changed */
   if (swapPoolTable[frameIdx].spte_asid != ASID_UNOCCUPIED) {
-    int oldAsid = swapPoolTable[frameIdx].spte_asid;
-    unsigned int oldVpn = swapPoolTable[frameIdx].spte_vpn;
-    pte_t *oldPte = swapPoolTable[frameIdx].spte_pte;
-
-    /* 8.(a) Update old process's Page Table (V=0) */
-    unsigned int status = getSTATUS();
-    setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
-    oldPte->pte_entryLO &= ~PTE_VALID;
-
-    /* 8.(b). Update TLB if cached - Atomic with 8.(a) */
-    setENTRYHI(oldPte->pte_entryHI);
-    TLBP(); /* Probe TLB */
-    if (!(getINDEX() & TLB_PRESENT)) {
-      /* P=0: Match found */
-      setENTRYLO(oldPte->pte_entryLO);
-      TLBWI(); /* Update TLB atomically */
-    }
-    setSTATUS(status); /* Reenable interrupts */
-
-    /*
-     * Why update Page Table/TLB before writing to backing store?
-     *
-     * If we wrote to flash first, then an interrupt (e.g., another Pager) could
-     * run and see the old Page Table entry (V=1) still pointing to this frame.
-     * It might reuse or overwrite the frame before the write completes, leading
-     * to data corruption in the backing store. Updating Page Table (V=0) and
-     * TLB first ensures the frame is marked invalid and uncached, preventing
-     * access during the write. Order matters for data integrity.
-     */
-
-    /* 8.(c). Write to old process's backing store */
-    memaddr frameAddr = swapPool + (frameIdx * PAGESIZE);
-    int oldPageIdx = vpnToPageIndex(oldVpn);
-    int sectorNum = IS_SHARED_VPN(oldVpn)
-                        ? KUSEG_BASE_SECTOR + oldPageIdx
-                        : (oldAsid - 1) * MAXPAGES + oldPageIdx;
-
-    if (diskOperation(BACKING_DISK, sectorNum, frameAddr, DISK_WRITEBLK) < 0) {
+    if (evictFrame(frameIdx) < 0) {
       SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
       programTrapHandler(sup); /* I/O error as trap */
     }
   }
 
-  /* 9. Read current process's page p into frame i */
+  /* 9. Read current process's page p into frame i, from DISK0 if it has
+   * been written there and from the flash device otherwise */
   memaddr frameAddr = swapPool + (frameIdx * PAGESIZE);
-  int sectorNum = IS_SHARED_VPN(vpn) ? KUSEG_BASE_SECTOR + pageIdx
-                                     : (sup->sup_asid - 1) * MAXPAGES + pageIdx;
+  int result;
+  if (IS_SHARED_VPN(vpn)) {
+    result = diskOperation(BACKING_DISK, sharedBaseSector + pageIdx,
+                           frameAddr, DISK_READBLK);
+  } else if (pageSector[sup->sup_asid][pageIdx] != NO_SECTOR) {
+    result = diskOperation(BACKING_DISK, pageSector[sup->sup_asid][pageIdx],
+                           frameAddr, DISK_READBLK);
+  } else {
+    result = loadFreshPage(sup, pageIdx, frameAddr);
+  }
 
-  if (diskOperation(BACKING_DISK, sectorNum, frameAddr, DISK_READBLK) < 0) {
+  if (result < 0) {
     SYSCALL(VERHOGEN, (int)&swapPoolSem, 0, 0);
     programTrapHandler(sup); /* I/O error as trap */
   }
 
   /* 10. Update Swap Pool table */
   int asid;
-  pte_t *pte;
   unsigned int entryLO;
   if (IS_SHARED_VPN(vpn)) {
     asid = 0;
-    pte = &globalPgTbl[pageIdx];
     entryLO = (frameAddr & PFN_MASK) | PTE_DIRTY | PTE_VALID | PTE_GLOBAL;
   } else {
+    /* Read-only until the first write marks it dirty */
     asid = sup->sup_asid;
-    pte = &sup->sup_privatePgTbl[pageIdx];
-    entryLO = (frameAddr & PFN_MASK) | PTE_DIRTY | PTE_VALID;
+    entryLO = (frameAddr & PFN_MASK) | PTE_VALID;
   }
 
   swapPoolTable[frameIdx].spte_asid = asid;
   swapPoolTable[frameIdx].spte_vpn = vpn;
   swapPoolTable[frameIdx].spte_pte = pte;
+  swapPoolTable[frameIdx].spte_refs = 1;
+  swapPoolTable[frameIdx].spte_dirty = FALSE;
 
-  /* 11. Update Page Table (PFN and V=1) */
-  unsigned int status = getSTATUS();
-  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
-  pte->pte_entryLO = entryLO;
-
-  /* 12. Update TLB (atomic with 11) */
-  setENTRYHI(pte->pte_entryHI);
-  TLBP();
-  setENTRYLO(pte->pte_entryLO);
-  if (!(getINDEX() & TLB_PRESENT)) {
-    /* P=0: Match found */
-    TLBWI();
-  } else {
-    /* P=1: No match, add new entry */
-    TLBWR(); /* Random slot */
-  }
-  setSTATUS(status); /* Reenable interrupts */
+  /* 11 & 12. Update Page Table (PFN and V=1) and TLB atomically */
+  mapPage(pte, entryLO);
 
   /*
    * Why read from backing store before updating Page Table/TLB?
@@ -9,6 +9,7 @@
 #include "../h/deviceSupportChar.h"
 
 #include "../h/initProc.h"
+#include "../h/printSpooler.h"
 #include "../h/scheduler.h"
 #include "../h/sysSupport.h"
 #include "../h/vmSupport.h"
@@ -17,9 +18,16 @@
 /**
  * @brief Implement WRITEPRINTER syscall for U-procs.
  *
- * - Validates that the string lies entirely within KUSEG.
- * - Sends each character to the printer device and waits for acknowledgment.
- * - Sets `s_v0` to the number of characters printed or a negative error code.
+ * - Validates, page by page, that the string lies entirely within KUSEG.
+ *   There is no length limit.
+ * - Copies the string into the printer's spool queue in PRINTER_MAXLEN
+ *   chunks and returns once the last chunk is queued; the printer daemon
+ *   prints it in the background (see printSpooler.c).
+ * - With a3 = PRINT_POOLED the job may be printed on any idle printer.
+ * - Sets `s_v0` to the number of characters accepted, to ERR if no printer
+ *   is installed, or to the negated status of an earlier spooled job that
+ *   failed. SYS21 (PRINTFLUSH) waits for the
+ *   spooled output to be printed.
  *
  * @param excState Pointer to the saved exception state of the current U-proc.
  * @param sup Pointer to the support structure of the current U-proc.
@@ -28,59 +36,32 @@ void sysWriteToPrinter(state_t *excState, support_t *sup) {
   memaddr virtAddr = excState->s_a1;
   /* if len < 0, then len will be a very large number due to overflow */
   unsigned int len = excState->s_a2;
-  int devNum = sup->sup_asid - 1; /* ASID 1-8 -> 0-7 */
-  int devIdx = (PRNTINT - DISKINT) * DEVPERINT + devNum;
-  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
-  device_t *printer = &busRegArea->devreg[devIdx];
-
-  /* Validate inputs: entire string must be in KUSEG
-   * Note that if (virtAddr + len - 1) >= MAXADDR, then the number will be
-   * wrapped around and smaller than KUSEG */
-  if (!isValidAddr(virtAddr) || len > PRINTER_MAXLEN ||
-      !isValidAddr(virtAddr + len - 1)) {
-    programTrapHandler(sup);
-  }
-
-  SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
+  int owner = sup->sup_asid - 1; /* ASID 1-MAX_UPROCS -> spool client */
 
-  /* Send each character up to len */
-  char *s = (char *)virtAddr;
-  int result = READY; /* Default for len = 0 */
-  unsigned i = 0;
-  while (i < len && result == READY) {
-    /* Prepare data */
-    printer->d_data0 = s[i];
-
-    /* Disable interrupts to ensure writing the COMMAND field and executing SYS5
-     * (WAITIO) happens atomically */
-    unsigned int status = getSTATUS();
-    setSTATUS(status & ~STATUS_IEC);
-    printer->d_command = PRINTCHR;
-    result = SYSCALL(WAITIO, PRNTINT, devNum, 0);
-    setSTATUS(status); /* Reenable interrupts */
-
-    i++;
-  }
-
-  if (result == READY) {
-    /* Success: all chars sent */
-    excState->s_v0 = len;
-  } else {
-    /* Error: negative status */
-    excState->s_v0 = -result;
+  /* Validate inputs: entire string must be in KUSEG (a wrapped-around
+   * buffer is rejected too) */
+  if (!isValidRange(virtAddr, len)) {
+    programTrapHandler(sup);
   }
 
-  SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
+  excState->s_v0 =
+      spoolSubmit(owner, sup->sup_dev.b_printer, (char *)virtAddr, len,
+                  excState->s_a3 == PRINT_POOLED);
   switchContext(excState);
 }
 
 /**
  * @brief Implement WRITETERMINAL syscall for U-procs.
  *
- * - Validates the input string buffer in KUSEG.
- * - Sends each character to the terminal transmitter.
- * - Waits for acknowledgment per character.
+ * - Validates, page by page, that the string lies in KUSEG. There is no
+ *   length limit.
+ * - Streams the string, TERMINAL_MAXLEN characters at a time, into the
+ *   terminal's Nucleus transmit ring (SYS41); the interrupt handler transmits
+ *   it while the U-proc keeps running. The U-proc is only blocked while the
+ *   ring is full.
  * - Returns number of characters written or negative error code in `s_v0`.
+ *   Since output is asynchronous, a transmission error is reported by the
+ *   next write to the same terminal.
  *
  * @param excState Pointer to the saved exception state of the current U-proc.
  * @param sup Pointer to the support structure of the current U-proc.
@@ -88,53 +69,78 @@ void sysWriteToPrinter(state_t *excState, support_t *sup) {
 void sysWriteToTerminal(state_t *excState, support_t *sup) {
   memaddr virtAddr = excState->s_a1;
   unsigned len = excState->s_a2;
-  int devNum = sup->sup_asid - 1; /* ASID 1-8 -> 0-7 */
+  int devNum = sup->sup_dev.b_terminal;
   int devIdx = (TERMINT - DISKINT) * DEVPERINT + devNum;
-  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
-  device_t *terminal = &busRegArea->devreg[devIdx];
 
   /* Validate inputs: entire string must be in KUSEG */
-  if (!isValidAddr(virtAddr) || len > TERMINAL_MAXLEN ||
-      !isValidAddr(virtAddr + len - 1)) {
+  if (!isValidRange(virtAddr, len)) {
     programTrapHandler(sup);
   }
 
   SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
 
-  /* Send each character up to len */
+  char kbuf[TERMINAL_MAXLEN];
   char *s = (char *)virtAddr;
-  int result = CHAR_TRANSMITTED; /* Default for len = 0 */
-  unsigned i = 0;
-  while (i < len && (result & TERMINT_STATUS_MASK) == CHAR_TRANSMITTED) {
-    /* Disable interrupts to ensure writing the COMMAND field and executing SYS5
-     * (WAITIO) happens atomically */
-    unsigned int status = getSTATUS();
-    setSTATUS(status & ~STATUS_IEC);
-    terminal->t_transm_command = TRANSMITCHAR | (s[i] << BYTELEN);
-    result = SYSCALL(WAITIO, TERMINT, devNum, FALSE);
-    setSTATUS(status); /* Reenable interrupts */
-
-    i++;
+  int result = 0;
+  unsigned done = 0;
+  while (done < len && result >= 0) {
+    /* The Nucleus must not touch KUSEG, so stage each chunk in kernel
+     * memory */
+    unsigned chunk = len - done;
+    if (chunk > TERMINAL_MAXLEN) {
+      chunk = TERMINAL_MAXLEN;
+    }
+    unsigned i;
+    for (i = 0; i < chunk; i++) {
+      kbuf[i] = s[done + i];
+    }
+
+    /* Hand the chunk to the transmit ring, possibly in several pieces if
+     * the ring fills up */
+    unsigned sent = 0;
+    while (sent < chunk && result >= 0) {
+      result = SYSCALL(WRITETERMBUF, devNum, (int)&kbuf[sent], chunk - sent);
+      if (result > 0) {
+        sent += result;
+      }
+    }
+    done += sent;
   }
 
-  if ((result & TERMINT_STATUS_MASK) == CHAR_TRANSMITTED) {
-    /* Success: all chars sent */
+  if (result >= 0) {
+    /* Success: all chars queued for transmission */
     excState->s_v0 = len;
   } else {
     /* Error: negative status */
-    excState->s_v0 = -result;
+    excState->s_v0 = result;
   }
 
   SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
   switchContext(excState);
 }
 
+/**
+ * @brief Wait until a U-proc's terminal output has been transmitted.
+ *
+ * SYS12 returns as soon as the characters are in the transmit ring, so a
+ * terminating U-proc calls this to keep the tail of its output from being
+ * lost when it (or the whole system) goes away.
+ *
+ * @param sup Pointer to the support structure of the U-proc.
+ */
+void termFlush(support_t *sup) {
+  SYSCALL(WRITETERMBUF, sup->sup_dev.b_terminal, 0, 0);
+}
+
 /**
  * @brief Implement READTERMINAL syscall for U-procs.
  *
- * - Repeatedly reads characters from the terminal receiver until a newline  or
- * error occurs.
- * - Validates that each character is written to a valid KUSEG address.
+ * - Takes the next line from the terminal's Nucleus read-ahead buffer (SYS42),
+ *   which the interrupt handler keeps filling between reads, so a line that
+ *   has already been typed is returned without waiting on the device.
+ * - If `s_a2` is TRUE the read is non-blocking and returns whatever has been
+ *   received so far (possibly nothing) instead of waiting for a newline.
+ * - Validates that the destination lies in KUSEG before copying the line out.
  * - Returns the number of characters read or a negative error code in `s_v0`.
  *
  * @param excState Pointer to the saved exception state of the current U-proc.
@@ -142,53 +148,34 @@ void sysWriteToTerminal(state_t *excState, support_t *sup) {
  */
 void sysReadFromTerminal(state_t *excState, support_t *sup) {
   memaddr virtAddr = excState->s_a1;
-  int devNum = sup->sup_asid - 1; /* ASID 1-8 -> 0-7 */
+  int nonBlocking = excState->s_a2;
+  int devNum = sup->sup_dev.b_terminal;
   int devIdx = (TERMINT - DISKINT) * DEVPERINT + devNum;
   int semIdx = devIdx + DEVPERINT;
-  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
-  device_t *terminal = &busRegArea->devreg[devIdx];
 
   SYSCALL(PASSEREN, (int)&supportDeviceSem[semIdx], 0, 0);
 
-  /* Read each character up to len */
-  char *buffer = (char *)virtAddr;
-  int result;
-  int done = FALSE;
-
-  while (!done) {
-    /* Disable interrupts to ensure writing the COMMAND field and executing SYS5
-     * (WAITIO) happens atomically */
-    unsigned int status = getSTATUS();
-    setSTATUS(status & ~STATUS_IEC);
-    terminal->t_recv_command = RECEIVECHAR;
-    result = SYSCALL(WAITIO, TERMINT, devNum, TRUE);
-    setSTATUS(status); /* Reenable interrupts */
-
-    if ((result & TERMINT_STATUS_MASK) == CHAR_RECEIVED) {
-      char c = (result >> BYTELEN) & TERMINT_STATUS_MASK;
-      /* Validate each buffer address before writing */
-      if (!isValidAddr((memaddr)buffer)) {
-        SYSCALL(VERHOGEN, (int)&supportDeviceSem[semIdx], 0, 0);
-        programTrapHandler(sup); /* Buffer overflow */
-      }
-      *buffer = c;
-      buffer++;
-      if (c == '\n') {
-        done = TRUE;
-      }
-    } else {
-      done = TRUE;
+  /* The Nucleus must not touch KUSEG, so the line is staged in kernel memory */
+  char kbuf[TERM_RXBUF_SIZE];
+  int result = SYSCALL(READTERMBUF, devNum, (int)kbuf, nonBlocking);
+
+  if (result > 0) {
+    /* Validate the destination before writing */
+    if (!isValidAddr(virtAddr) || !isValidAddr(virtAddr + result - 1)) {
+      SYSCALL(VERHOGEN, (int)&supportDeviceSem[semIdx], 0, 0);
+      programTrapHandler(sup); /* Buffer overflow */
     }
-  }
 
-  if ((result & TERMINT_STATUS_MASK) == CHAR_RECEIVED) {
-    /* Success: all chars read */
-    excState->s_v0 = buffer - (char *)virtAddr;
-  } else {
-    /* Error: negative status */
-    excState->s_v0 = -result;
+    char *buffer = (char *)virtAddr;
+    int i;
+    for (i = 0; i < result; i++) {
+      buffer[i] = kbuf[i];
+    }
   }
 
+  /* Number of characters read, or negative status on error */
+  excState->s_v0 = result;
+
   SYSCALL(VERHOGEN, (int)&supportDeviceSem[semIdx], 0, 0);
   switchContext(excState);
 }
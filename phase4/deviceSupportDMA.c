@@ -162,6 +162,12 @@ int diskOperation(unsigned int diskNum, unsigned int sectorNum,
  * @brief Shared handler for SYS16/17 flash I/O. Handles DMA setup, user/kernel
  * data copy, and flash I/O.
  *
+ * The data is staged in the U-proc's private DMA page, so the flash device is
+ * only held for the I/O itself. The copies may page fault, and the Pager may
+ * need the same flash device to fault in a page of an image. Before a write,
+ * the block is saved to DISK0 for the U-procs whose image still reads it from
+ * the flash device (see saveImageBlock()).
+ *
  * @param excState Saved exception state of U-proc.
  * @param sup      Pointer to U‑proc support structure.
  * @param op       FLASH_READBLK or FLASH_WRITEBLK.
@@ -194,27 +200,31 @@ HIDDEN void sysFlashOperation(state_t *excState, support_t *sup,
     switchContext(excState);
   }
 
-  /* Compute DMA buffer address in kernel memory for the flash device */
-  memaddr dmaBuf = FLASH_DMA_BASE + flashNum * PAGESIZE;
-
-  /* Gain exclusive access to the device register and DMA buffer */
-  SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
+  /* The U-proc's private DMA buffer in kernel memory */
+  memaddr dmaBuf = sup->sup_dmaBuf;
 
-  /* If writing: copy one page from user space to kernel DMA buffer */
+  /* If writing: keep the old block for U-procs whose image it is part of,
+   * then copy one page from user space to kernel DMA buffer */
   if (op == FLASH_WRITEBLK) {
+    int saved = saveImageBlock(flashNum, blockNum, dmaBuf);
+    if (saved != READY) {
+      excState->s_v0 = saved;
+      switchContext(excState);
+    }
     memcopy((void *)dmaBuf, (void *)logicalAddr, PAGESIZE);
   }
 
+  /* Gain exclusive access to the device register */
+  SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
   excState->s_v0 = flashOperation(flashNum, blockNum, dmaBuf, op);
+  /* Release device semaphore */
+  SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
 
   /* If reading: copy one page from DMA buffer into user space */
   if (excState->s_v0 == READY && op == FLASH_READBLK) {
     memcopy((void *)logicalAddr, (void *)dmaBuf, PAGESIZE);
   }
 
-  /* Release device semaphore */
-  SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
-
   /* Resume user process */
   switchContext(excState);
 }
@@ -251,6 +261,31 @@ int flashOperation(unsigned int flashNum, unsigned int blockNum,
   return (result == READY) ? result : -result;
 }
 
+/**
+ * @brief Read the header of the U-proc image on a flash device (block 0) and
+ * compute the number of pages holding its .text and .data sections.
+ *
+ * @param flashNum flash device number in [0..7]
+ * @param dmaBuf Physical address of a 4KB DMA buffer owned by the caller
+ * @return Number of pages on success, or −status on failure.
+ */
+int readImagePages(unsigned int flashNum, memaddr dmaBuf) {
+  int devIdx = (FLASHINT - DISKINT) * DEVPERINT + flashNum;
+
+  SYSCALL(PASSEREN, (int)&supportDeviceSem[devIdx], 0, 0);
+  int result = flashOperation(flashNum, 0, dmaBuf, FLASH_READBLK);
+  SYSCALL(VERHOGEN, (int)&supportDeviceSem[devIdx], 0, 0);
+
+  if (result < 0) {
+    return result;
+  }
+
+  /* Extract the .text and .data file sizes from the header */
+  int textFileSize = *(int *)(dmaBuf + TEXT_FILE_SIZE_OFFSET);
+  int dataFileSize = *(int *)(dmaBuf + DATA_FILE_SIZE_OFFSET);
+  return (textFileSize + dataFileSize) / PAGESIZE;
+}
+
 /**
  * @brief SYS14: Write one page (4KB) to a disk sector
  *
@@ -0,0 +1,484 @@
+/**
+ * @file printSpooler.c
+ * @author Dang Truong, Loc Pham
+ * @brief Implements the printer spooler. SYS11 copies a print job into a
+ * kernel spool queue and returns immediately; one daemon process per installed
+ * printer drains that printer's queue with whole-string Nucleus transfers.
+ * SYS21 (PRINTFLUSH) lets a U-proc wait until its spooled jobs are printed.
+ *
+ * In pooled mode (SYS11 with a3 = PRINT_POOLED) a job is not bound to the
+ * U-proc's own printer: it is handed to the least busy idle printer, or held
+ * in a shared pool queue until some printer's daemon runs out of work.
+ * Per-printer utilisation statistics are read with SYS22 (PRINTSTATS).
+ *
+ * A write longer than PRINTER_MAXLEN is streamed as a run of jobs that all go
+ * to the same printer, which is reserved for the run so that no pooled job is
+ * printed in the middle of it.
+ * @date 2025-05-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/printSpooler.h"
+
+#include "../h/const.h"
+#include "../h/scheduler.h"
+#include "../h/supportAlloc.h"
+#include "../h/sysSupport.h"
+#include "../h/types.h"
+#include "../h/vmSupport.h"
+#include "umps3/umps/libumps.h"
+
+/* Spooled print job */
+typedef struct spoolJob_t {
+  struct spoolJob_t *j_next; /* next job in a queue or in the free list */
+  int j_owner;               /* submitting U-proc (ASID - 1)            */
+  int j_len;                 /* number of characters to print           */
+  char j_buf[PRINTER_MAXLEN];  /* characters to print                   */
+} spoolJob_t;
+
+/* Per-printer spool state */
+typedef struct spoolQueue_t {
+  spoolJob_t *q_head;      /* oldest queued job                          */
+  spoolJob_t *q_tail;      /* newest queued job                          */
+  int q_jobsSem;           /* counts queued jobs; the daemon P's on it   */
+  int q_load;              /* jobs queued or being printed               */
+  int q_streams;           /* multi-chunk writes still being queued      */
+  printStats_t q_stats;    /* utilisation statistics                     */
+} spoolQueue_t;
+
+/* Per-U-proc spool state: flushes and errors follow the submitter, since a
+ * pooled job may be printed on any printer */
+typedef struct spoolClient_t {
+  int c_pending;           /* jobs submitted but not yet printed         */
+  int c_flushSem;          /* U-proc waiting for c_pending to reach 0    */
+  int c_flushWaiters;      /* number of U-procs blocked on c_flushSem    */
+  unsigned int c_error;    /* status of the last failed job, 0 if none   */
+} spoolClient_t;
+
+/* Free job descriptors (NULL-terminated singly linked list) */
+HIDDEN spoolJob_t *spoolJobFree_h;
+
+/* Counts free job descriptors; submitters block on it when the spool is full */
+HIDDEN int spoolFreeSem;
+
+/* One spool queue per printer */
+HIDDEN spoolQueue_t spoolQueues[DEVPERINT];
+
+/* One client record per U-proc */
+HIDDEN spoolClient_t spoolClients[MAX_UPROCS];
+
+/* Pooled jobs waiting for any printer to become idle */
+HIDDEN spoolJob_t *poolHead;
+HIDDEN spoolJob_t *poolTail;
+
+/* Bitmap of installed printers (bit i = printer i) */
+HIDDEN unsigned int spoolInstalled;
+
+/* Mutual exclusion over all of the above */
+HIDDEN int spoolMutex;
+
+/* ==================== Local Function Declarations ==================== */
+HIDDEN void printerDaemon(int printerNum);
+HIDDEN void finishJob(int printerNum, spoolJob_t *job, int status,
+                      cpu_t busyTime);
+HIDDEN void appendJob(spoolJob_t **head, spoolJob_t **tail, spoolJob_t *job);
+HIDDEN spoolJob_t *removeJob(spoolJob_t **head, spoolJob_t **tail);
+HIDDEN void dispatchJob(int printerNum, spoolJob_t *job);
+HIDDEN int pickPrinter(int idleOnly);
+
+/* ==================== Public Function Definitions ==================== */
+
+/**
+ * @brief Initialize the spool queues and launch one printer daemon for each
+ * installed printer.
+ */
+void initSpooler() {
+  static spoolJob_t spoolJobs[SPOOL_JOBS];
+
+  spoolJobFree_h = NULL;
+  int i;
+  for (i = 0; i < SPOOL_JOBS; i++) {
+    spoolJobs[i].j_next = spoolJobFree_h;
+    spoolJobFree_h = &spoolJobs[i];
+  }
+  spoolFreeSem = SPOOL_JOBS;
+  spoolMutex = 1;
+  poolHead = poolTail = NULL;
+
+  devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+  spoolInstalled = busRegArea->inst_dev[PRNTINT - DISKINT];
+
+  for (i = 0; i < MAX_UPROCS; i++) {
+    spoolClient_t *client = &spoolClients[i];
+    client->c_pending = 0;
+    client->c_flushSem = 0;
+    client->c_flushWaiters = 0;
+    client->c_error = 0;
+  }
+
+  for (i = 0; i < DEVPERINT; i++) {
+    spoolQueue_t *queue = &spoolQueues[i];
+    queue->q_head = queue->q_tail = NULL;
+    queue->q_jobsSem = 0;
+    queue->q_load = 0;
+    queue->q_streams = 0;
+    queue->q_stats.ps_jobs = 0;
+    queue->q_stats.ps_chars = 0;
+    queue->q_stats.ps_errors = 0;
+    queue->q_stats.ps_busyTime = 0;
+
+    if (!(spoolInstalled & DEV_BIT(i))) {
+      /* No printer, no daemon: jobs for it would never be printed */
+      continue;
+    }
+
+    /* Prepare the daemon's processor state: kernel mode, interrupts and
+     * timers enabled, kernel ASID (0), printer number as its argument */
+    state_t daemonState;
+    daemonState.s_pc = daemonState.s_t9 = (memaddr)printerDaemon;
+    daemonState.s_sp = stackAlloc();
+    daemonState.s_a0 = i;
+    daemonState.s_status = STATUS_IEP | STATUS_IM_ALL_ON | STATUS_TE;
+    daemonState.s_entryHI = (0 << ASID_SHIFT);
+
+    if (daemonState.s_sp == 0 ||
+        SYSCALL(CREATEPROCESS, (int)&daemonState, (int)NULL, 0) == ERR) {
+      SYSCALL(TERMINATEPROCESS, 0, 0, 0);
+    }
+  }
+}
+
+/**
+ * @brief Add a print job to the spool.
+ *
+ * The string is copied PRINTER_MAXLEN characters at a time into job
+ * descriptors; the call blocks only while every descriptor is in use. The
+ * characters are read from the caller's address space, which must already
+ * have been validated.
+ *
+ * @param owner Submitting U-proc (ASID - 1).
+ * @param printer Printer the U-proc is bound to (0-7). If it is not
+ * installed, the output is printed on the least loaded installed printer.
+ * @param src Characters to print.
+ * @param len Number of characters (any length).
+ * @param pooled TRUE to print on any idle printer instead of the owner's.
+ * @return len on success, ERR if no printer is installed, or the negated
+ * status of an earlier failed job of this U-proc (the new output is then not
+ * queued in either case).
+ */
+int spoolSubmit(int owner, int printer, char *src, unsigned int len,
+                int pooled) {
+  spoolClient_t *client = &spoolClients[owner];
+
+  /* Report a failure of an earlier job before accepting new output */
+  SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+  if (client->c_error != 0) {
+    int error = -client->c_error;
+    client->c_error = 0;
+    SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+    return error;
+  }
+  SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+
+  /* Without a printer daemon the jobs would never be printed */
+  if (spoolInstalled == 0) {
+    return ERR;
+  }
+
+  int multiChunk = len > PRINTER_MAXLEN;
+  int printerNum = -1; /* printer the chunks go to, -1 until chosen */
+  unsigned int done = 0;
+  while (done < len) {
+    unsigned int chunk = len - done;
+    if (chunk > PRINTER_MAXLEN) {
+      chunk = PRINTER_MAXLEN;
+    }
+
+    /* Reserve a job descriptor, waiting for the daemons if the spool is
+     * full */
+    SYSCALL(PASSEREN, (int)&spoolFreeSem, 0, 0);
+    SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+    spoolJob_t *job = spoolJobFree_h;
+    spoolJobFree_h = job->j_next;
+    SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+
+    /* Copy outside the mutex: reading the U-proc's pages may page fault */
+    unsigned int i;
+    for (i = 0; i < chunk; i++) {
+      job->j_buf[i] = src[done + i];
+    }
+    job->j_owner = owner;
+    job->j_len = chunk;
+    done += chunk;
+
+    SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+    client->c_pending++;
+    if (printerNum < 0) {
+      /* First chunk: choose the printer */
+      if (!pooled && (spoolInstalled & DEV_BIT(printer))) {
+        printerNum = printer;
+      } else {
+        /* A single pooled job may wait in the pool for any printer, but the
+         * chunks of a longer write must stay in order on one printer, and
+         * output for a printer that is not installed goes to one that is */
+        printerNum = pickPrinter(pooled && !multiChunk);
+      }
+      if (printerNum >= 0 && multiChunk) {
+        spoolQueues[printerNum].q_streams++;
+      }
+    }
+    if (printerNum < 0) {
+      appendJob(&poolHead, &poolTail, job);
+    } else {
+      dispatchJob(printerNum, job);
+    }
+    if (multiChunk && done == len) {
+      spoolQueues[printerNum].q_streams--;
+    }
+    SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+  }
+
+  return len;
+}
+
+/**
+ * @brief Wait until every job spooled by a U-proc has been printed.
+ *
+ * @param owner U-proc (ASID - 1) whose jobs to wait for.
+ * @return OK if all jobs were printed, or the negated status of a failed job.
+ */
+int spoolFlush(int owner) {
+  spoolClient_t *client = &spoolClients[owner];
+
+  SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+  if (client->c_pending > 0) {
+    client->c_flushWaiters++;
+
+    /* Atomically release the spool mutex and wait for the jobs to drain */
+    unsigned int status = getSTATUS();
+    setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+    SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+    SYSCALL(PASSEREN, (int)&client->c_flushSem, 0, 0);
+    setSTATUS(status); /* Reenable interrupts */
+
+    SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+  }
+
+  int result = OK;
+  if (client->c_error != 0) {
+    result = -client->c_error;
+    client->c_error = 0;
+  }
+  SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+
+  return result;
+}
+
+/**
+ * @brief Implements SYS21: wait until the calling U-proc's spooled print jobs
+ * have been printed.
+ *
+ * Returns OK in `s_v0`, or the negated device status if a job failed.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ */
+void sysPrintFlush(state_t *excState, support_t *sup) {
+  excState->s_v0 = spoolFlush(sup->sup_asid - 1); /* ASID -> spool client */
+  switchContext(excState);
+}
+
+/**
+ * @brief Implements SYS22: copy a printer's utilisation statistics into a
+ * printStats_t in the caller's address space.
+ *
+ * - a1: printer number (0-7).
+ * - a2: virtual address of the printStats_t to fill.
+ * - Returns OK in `s_v0`, or ERR if the printer is not installed.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ */
+void sysPrintStats(state_t *excState, support_t *sup) {
+  int printerNum = excState->s_a1;
+  memaddr virtAddr = excState->s_a2;
+
+  if (printerNum < 0 || printerNum >= DEVPERINT || !isValidAddr(virtAddr) ||
+      !isValidAddr(virtAddr + sizeof(printStats_t) - 1)) {
+    programTrapHandler(sup);
+  }
+
+  if (!(spoolInstalled & DEV_BIT(printerNum))) {
+    excState->s_v0 = ERR;
+    switchContext(excState);
+  }
+
+  SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+  printStats_t stats = spoolQueues[printerNum].q_stats;
+  SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+
+  /* Copy outside the mutex: writing the U-proc's page may page fault */
+  *(printStats_t *)virtAddr = stats;
+
+  excState->s_v0 = OK;
+  switchContext(excState);
+}
+
+/* ==================== Printer Daemon ==================== */
+
+/**
+ * @brief Daemon process that drains one printer's spool queue.
+ *
+ * Each job is sent with a single SYS43 transfer, so the daemon is woken once
+ * per job rather than once per character.
+ *
+ * @param printerNum Printer number (0-7) served by this daemon.
+ */
+HIDDEN void printerDaemon(int printerNum) {
+  spoolQueue_t *queue = &spoolQueues[printerNum];
+  int devIdx = (PRNTINT - DISKINT) * DEVPERINT + printerNum;
+
+  while (TRUE) {
+    /* 1. Wait for a job */
+    SYSCALL(PASSEREN, (int)&queue->q_jobsSem, 0, 0);
+
+    /* 2. Dequeue it */
+    SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+    spoolJob_t *job = removeJob(&queue->q_head, &queue->q_tail);
+    SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+
+    /* 3. Print it, timing how long the printer is busy */
+    cpu_t startTOD, endTOD;
+    STCK(startTOD);
+    int status = SYSCALL(XFERSTRING, devIdx, (int)job->j_buf, job->j_len);
+    STCK(endTOD);
+
+    /* 4. Recycle the descriptor and pick up pooled work if idle */
+    finishJob(printerNum, job, status, endTOD - startTOD);
+  }
+}
+
+/* ==================== Spool Helpers ==================== */
+
+/**
+ * @brief Account for a printed job: update the printer's statistics, record a
+ * failure against the submitter, return the descriptor to the free list, wake
+ * the submitter's flushers once all its jobs are done, and pull the next
+ * pooled job if this printer has nothing else queued.
+ *
+ * @param printerNum Printer number (0-7) that printed the job.
+ * @param job The job that was printed.
+ * @param status Final device status of the transfer.
+ * @param busyTime Microseconds the transfer took.
+ */
+HIDDEN void finishJob(int printerNum, spoolJob_t *job, int status,
+                      cpu_t busyTime) {
+  spoolQueue_t *queue = &spoolQueues[printerNum];
+  spoolClient_t *client = &spoolClients[job->j_owner];
+
+  SYSCALL(PASSEREN, (int)&spoolMutex, 0, 0);
+  queue->q_stats.ps_jobs++;
+  queue->q_stats.ps_chars += job->j_len;
+  queue->q_stats.ps_busyTime += busyTime;
+  if (status != READY) {
+    queue->q_stats.ps_errors++;
+    client->c_error = status;
+  }
+
+  job->j_next = spoolJobFree_h;
+  spoolJobFree_h = job;
+
+  client->c_pending--;
+  if (client->c_pending == 0) {
+    while (client->c_flushWaiters > 0) {
+      client->c_flushWaiters--;
+      SYSCALL(VERHOGEN, (int)&client->c_flushSem, 0, 0);
+    }
+  }
+
+  queue->q_load--;
+  if (queue->q_head == NULL && queue->q_streams == 0 && poolHead != NULL) {
+    dispatchJob(printerNum, removeJob(&poolHead, &poolTail));
+  }
+  SYSCALL(VERHOGEN, (int)&spoolMutex, 0, 0);
+
+  SYSCALL(VERHOGEN, (int)&spoolFreeSem, 0, 0);
+}
+
+/**
+ * @brief Append a job to the tail of a FIFO job queue.
+ *
+ * @param head Pointer to the queue's head pointer.
+ * @param tail Pointer to the queue's tail pointer.
+ * @param job The job to append.
+ */
+HIDDEN void appendJob(spoolJob_t **head, spoolJob_t **tail, spoolJob_t *job) {
+  job->j_next = NULL;
+  if (*tail == NULL) {
+    *head = job;
+  } else {
+    (*tail)->j_next = job;
+  }
+  *tail = job;
+}
+
+/**
+ * @brief Remove the job at the head of a non-empty FIFO job queue.
+ *
+ * @param head Pointer to the queue's head pointer.
+ * @param tail Pointer to the queue's tail pointer.
+ * @return The removed job.
+ */
+HIDDEN spoolJob_t *removeJob(spoolJob_t **head, spoolJob_t **tail) {
+  spoolJob_t *job = *head;
+  *head = job->j_next;
+  if (*head == NULL) {
+    *tail = NULL;
+  }
+  return job;
+}
+
+/**
+ * @brief Queue a job on a printer and notify its daemon. Caller holds
+ * spoolMutex.
+ *
+ * @param printerNum Printer number (0-7).
+ * @param job The job to print.
+ */
+HIDDEN void dispatchJob(int printerNum, spoolJob_t *job) {
+  spoolQueue_t *queue = &spoolQueues[printerNum];
+  appendJob(&queue->q_head, &queue->q_tail, job);
+  queue->q_load++;
+  SYSCALL(VERHOGEN, (int)&queue->q_jobsSem, 0, 0);
+}
+
+/**
+ * @brief Choose a printer for pooled output. Caller holds spoolMutex.
+ *
+ * With idleOnly, only installed printers with no queued or in-progress job
+ * (and no write being streamed to them) qualify, and the one that has been
+ * busy the least wins. Otherwise the installed printer with the fewest
+ * outstanding jobs wins, ties going to the one busy the least.
+ *
+ * @param idleOnly TRUE to consider idle printers only.
+ * @return Printer number (0-7), or -1 if no printer qualifies.
+ */
+HIDDEN int pickPrinter(int idleOnly) {
+  int best = -1;
+  int i;
+  for (i = 0; i < DEVPERINT; i++) {
+    spoolQueue_t *queue = &spoolQueues[i];
+    if (!(spoolInstalled & DEV_BIT(i)) ||
+        (idleOnly && (queue->q_load > 0 || queue->q_streams > 0))) {
+      continue;
+    }
+    if (best < 0 || queue->q_load < spoolQueues[best].q_load ||
+        (queue->q_load == spoolQueues[best].q_load &&
+         queue->q_stats.ps_busyTime < spoolQueues[best].q_stats.ps_busyTime)) {
+      best = i;
+    }
+  }
+  return best;
+}
@@ -2,9 +2,11 @@
  * @file delayDaemon.c
  * @author Dang Truong, Loc Pham
  * @brief Implements Phase 5 (Level 6) Delay Facility. Handles the
- * initialization of Active Delay List (ADL) and delay event descriptor free
- * list, delay system call (SYS18), and delay daemon for waking up U-procs after
- * requested sleep time.
+ * initialization of the Active Delay List (ADL), the delay system calls (SYS18
+ * in seconds, SYS27 in microseconds), and the delay daemon for waking up
+ * U-procs after the requested sleep time. The ADL is a binary min-heap, and the
+ * daemon sleeps until the earliest wake up time, or blocks while the ADL is
+ * empty, instead of polling every pseudo-clock tick.
  * @date 2025-04-24
  *
  * @copyright Copyright (c) 2025
@@ -19,61 +21,52 @@
 #include "../h/types.h"
 #include "umps3/umps/libumps.h"
 
-/* Delay event descriptor node */
+/* Delay event descriptor */
 typedef struct delayd_t {
-  struct delayd_t *d_next; /* next node in the ADL or free list */
-  cpu_t d_wakeTime;        /* system time when U-proc should be woken */
-  support_t *d_supStruct;  /* support structure of the sleeping U-proc */
+  cpu_t d_wakeTime;       /* system time when U-proc should be woken */
+  support_t *d_supStruct; /* support structure of the sleeping U-proc */
 } delayd_t;
 
-/* The sleeping U-proc list, implemented as a single, linearly linked list of
- * delay event descriptor nodes sorted by wake up time */
-HIDDEN delayd_t *delayd_h;
+/* The sleeping U-proc list, implemented as a binary min-heap of delay event
+ * descriptors ordered by wake up time */
+HIDDEN delayd_t adlHeap[ADL_SIZE];
+HIDDEN int adlCount;
 
-/* The free delay descriptor list, implemented as a NULL-terminated, single,
- * linearly linked list */
-HIDDEN delayd_t *delaydFree_h;
+/* Wake up time the Delay Daemon is sleeping until. Every U-proc in the ADL
+ * wakes at or after it; a U-proc due earlier sleeps in the Nucleus (SYS44)
+ * on its own instead of joining the ADL */
+HIDDEN cpu_t daemonWakeTime;
+
+/* TRUE while the ADL is empty and the Delay Daemon is blocked on daemonSem
+ * rather than sleeping until a wake up time */
+HIDDEN int daemonIdle;
+
+/* The idle Delay Daemon blocks here until a U-proc joins the ADL */
+HIDDEN int daemonSem;
 
 /* Mutual exclusion semaphore for ADL access (initialized to 1) */
 HIDDEN int adlMutex;
 
 /* ==================== Local Function Declarations ==================== */
 HIDDEN void delayDaemon();
-HIDDEN void initDelayd(delayd_t *delayd);
-HIDDEN void freeDelayd(delayd_t *delayd);
-HIDDEN delayd_t *allocDelayd();
-HIDDEN void insertDelayd(delayd_t *delayd);
-HIDDEN delayd_t *removeDelaydHead();
+HIDDEN void delayUntil(state_t *excState, support_t *sup, cpu_t wakeTime);
+HIDDEN int insertDelayd(cpu_t wakeTime, support_t *sup);
+HIDDEN support_t *removeDelaydHead();
+HIDDEN void swapDelayd(int i, int j);
 
 /* ==================== Public Function Definitions ==================== */
 
 /**
  * @brief Initialize the Active Delay List (ADL) and launch the Delay Daemon.
  *
- * Sets up the ADL with dummy head and tail nodes, populates the free list of
- * delay descriptors, initializes mutual exclusion, and creates the Delay
+ * Sets up an empty ADL, initializes mutual exclusion, and creates the Delay
  * Daemon.
  */
 void initADL() {
-  /* Static storage for ADL: MAX_UPROCS nodes + 2 dummy nodes */
-  static delayd_t delaydPool[MAX_UPROCS + 2];
-
-  /* Initialize ADL dummy head and tail */
-  delayd_h = &delaydPool[0];
-  delayd_t *tail = &delaydPool[1];
-  delayd_h->d_next = tail;
-  delayd_h->d_wakeTime = (cpu_t)0;
-  delayd_h->d_supStruct = NULL;
-  tail->d_next = NULL;
-  tail->d_wakeTime = (cpu_t)MAXINT;
-  tail->d_supStruct = NULL;
-
-  /* Populate the free list with remaining descriptors */
-  delaydFree_h = NULL;
-  int i;
-  for (i = 2; i < MAX_UPROCS + 2; i++) {
-    freeDelayd(&delaydPool[i]);
-  }
+  adlCount = 0;
+  daemonWakeTime = 0;
+  daemonIdle = FALSE;
+  daemonSem = 0;
 
   /* Initialize the mutual exclusion semaphore for ADL */
   adlMutex = 1;
@@ -106,10 +99,6 @@ void initADL() {
  * @brief Implements SYS18: Delay the calling U-proc for a specified number of
  * seconds.
  *
- * The U-proc is blocked on its private semaphore and scheduled to be woken
- * after `sleepTime` seconds by the Delay Daemon. Access to the shared Active
- * Delay List (ADL) is synchronized via `adlMutex`.
- *
  * @param excState Saved exception state containing syscall arguments
  * @param sup      Support structure of the requesting U-proc
  */
@@ -122,34 +111,31 @@ void sysDelay(state_t *excState, support_t *sup) {
     programTrapHandler(sup);
   }
 
-  /* Obtain mutual exclusion over the ADL */
-  SYSCALL(PASSEREN, (int)&adlMutex, 0, 0);
-
-  /* Try to get a delay descriptor node from the free list */
-  delayd_t *delayd = allocDelayd();
-  if (delayd == NULL) {
-    SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
-    programTrapHandler(sup);
-  }
-
   /* Compute wake-up time (in microseconds since boot) */
   cpu_t currentTime;
   STCK(currentTime);
-  delayd->d_wakeTime = currentTime + sleepTime * SECOND;
+  delayUntil(excState, sup, currentTime + sleepTime * SECOND);
+}
 
-  /* Associate this descriptor with the calling U-proc and insert it into ADL */
-  delayd->d_supStruct = sup;
-  insertDelayd(delayd);
+/**
+ * @brief Implements SYS27: Delay the calling U-proc for a specified number of
+ * microseconds.
+ *
+ * @param excState Saved exception state containing syscall arguments
+ * @param sup      Support structure of the requesting U-proc
+ */
+void sysDelayMicro(state_t *excState, support_t *sup) {
+  /* Extract requested delay duration (in microseconds) */
+  cpu_t sleepTime = excState->s_a1;
 
-  /* Atomically release ADL mutex and block U-proc on its private semaphore */
-  unsigned int status = getSTATUS();
-  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
-  SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
-  SYSCALL(PASSEREN, (int)&sup->sup_privateSem, 0, 0);
-  setSTATUS(status); /* Reenable interrupts */
+  if (sleepTime < 0) {
+    /* Reject negative sleep durations */
+    programTrapHandler(sup);
+  }
 
-  /* Control resumes here after wake-up; return to U-proc */
-  switchContext(excState);
+  cpu_t currentTime;
+  STCK(currentTime);
+  delayUntil(excState, sup, currentTime + sleepTime);
 }
 
 /* ==================== Delay Daemon ==================== */
@@ -157,130 +143,163 @@ void sysDelay(state_t *excState, support_t *sup) {
 /**
  * @brief Daemon process to manage delayed U-procs.
  *
- * This kernel-mode process wakes up every 100ms via SYS7 and checks the Active
- * Delay List (ADL) for expired timers. U-procs whose delay has expired are
+ * This kernel-mode process sleeps in the Nucleus (SYS44) until the earliest
+ * wake up time in the Active Delay List (ADL), skipping the pseudo-clock ticks
+ * in between. While the ADL is empty it blocks on `daemonSem` and costs
+ * nothing until a U-proc is delayed. U-procs whose delay has expired are
  * unblocked by performing a SYS4 (VERHOGEN) on their private semaphores.
  */
 HIDDEN void delayDaemon() {
   cpu_t currentTime;
 
   while (TRUE) {
-    /* 1. Wait for the next pseudo-clock tick (100ms) */
-    SYSCALL(WAITCLOCK, 0, 0, 0);
-
-    /* 2. Obtain mutual exclusion over the ADL */
+    /* 1. Obtain mutual exclusion over the ADL */
     SYSCALL(PASSEREN, (int)&adlMutex, 0, 0);
 
-    /* 3. Wake up all U-procs whose wake up time has passed */
+    /* 2. Wake up all U-procs whose wake up time has passed */
     STCK(currentTime);
-    while (delayd_h->d_next->d_wakeTime <= currentTime) {
-      delayd_t *delayd = removeDelaydHead();
-      if (delayd == NULL) {
-        /* Should never happen */
-        PANIC();
-      }
-
-      /* Wake the sleeping U-proc */
-      SYSCALL(VERHOGEN, (int)&delayd->d_supStruct->sup_privateSem, 0, 0);
-
-      /* Recycle the descriptor */
-      freeDelayd(delayd);
+    while (adlCount > 0 && adlHeap[0].d_wakeTime <= currentTime) {
+      support_t *sup = removeDelaydHead();
+      SYSCALL(VERHOGEN, (int)&sup->sup_privateSem, 0, 0);
     }
 
-    /* 4. Release mutual exclusion over the ADL */
-    SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
+    if (adlCount == 0) {
+      /* 3a. Nobody is sleeping: release the ADL and wait for a U-proc to be
+       * delayed */
+      daemonIdle = TRUE;
+      SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
+      SYSCALL(PASSEREN, (int)&daemonSem, 0, 0);
+    } else {
+      /* 3b. Release the ADL and sleep until the earliest wake up time
+       * (returns at once if it has already passed) */
+      daemonWakeTime = adlHeap[0].d_wakeTime;
+      SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
+      SYSCALL(WAITUNTIL, daemonWakeTime, 0, 0);
+    }
   }
 }
 
-/* ==================== ADL Node Management Helpers ==================== */
+/* ==================== Delay Helpers ==================== */
 
 /**
- * @brief Initialize a delay descriptor to default values.
+ * @brief Block the calling U-proc until a given system time.
  *
- * @param delayd Pointer to the delay descriptor node.
- */
-HIDDEN void initDelayd(delayd_t *delayd) {
-  delayd->d_next = NULL;
-  delayd->d_wakeTime = 0;
-  delayd->d_supStruct = NULL;
-}
-
-/**
- * @brief Return a delay descriptor to the free list by pushing the given
- * descriptor node to the head of the delaydFree list.
+ * If the Delay Daemon will run no later than the wake up time, the U-proc is
+ * inserted in the ADL and blocked on its private semaphore; an idle daemon is
+ * signalled so that it starts sleeping until the new wake up time. Access to
+ * the ADL is synchronized via `adlMutex`. If the sleeping daemon would wake it
+ * too late, the U-proc sleeps in the Nucleus until its own wake up time.
  *
- * @param delayd Pointer to the descriptor being returned.
+ * @param excState Saved exception state of the requesting U-proc
+ * @param sup      Support structure of the requesting U-proc
+ * @param wakeTime System time (microseconds since boot) to wake up at
  */
-HIDDEN void freeDelayd(delayd_t *delayd) {
-  /* Add the descriptor to the head of the free list */
-  delayd->d_next = delaydFree_h;
-  delaydFree_h = delayd;
-}
+HIDDEN void delayUntil(state_t *excState, support_t *sup, cpu_t wakeTime) {
+  /* Obtain mutual exclusion over the ADL */
+  SYSCALL(PASSEREN, (int)&adlMutex, 0, 0);
 
-/**
- * @brief Allocate a delay descriptor from the free list by removing the first
- * element from the delaydFree list, initializing it before use.
- *
- * @return Pointer to a reusable delay descriptor node, or NULL if none
- * available.
- */
-HIDDEN delayd_t *allocDelayd() {
-  if (delaydFree_h == NULL) {
-    /* No available delay descriptors */
-    return NULL;
+  if (!daemonIdle && wakeTime < daemonWakeTime) {
+    /* Due before the daemon runs again */
+    SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
+    SYSCALL(WAITUNTIL, wakeTime, 0, 0);
+    switchContext(excState);
   }
 
-  delayd_t *delayd = delaydFree_h;
-  delaydFree_h = delaydFree_h->d_next;
-  initDelayd(delayd);
+  /* Insert the calling U-proc into the ADL */
+  if (!insertDelayd(wakeTime, sup)) {
+    SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
+    programTrapHandler(sup);
+  }
+
+  if (daemonIdle) {
+    /* Wake the daemon: it will sleep until the earliest wake up time */
+    daemonIdle = FALSE;
+    SYSCALL(VERHOGEN, (int)&daemonSem, 0, 0);
+  }
+
+  /* Atomically release ADL mutex and block U-proc on its private semaphore */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  SYSCALL(VERHOGEN, (int)&adlMutex, 0, 0);
+  SYSCALL(PASSEREN, (int)&sup->sup_privateSem, 0, 0);
+  setSTATUS(status); /* Reenable interrupts */
 
-  return delayd;
+  /* Control resumes here after wake-up; return to U-proc */
+  switchContext(excState);
 }
 
+/* ==================== ADL Heap Helpers ==================== */
+
 /**
- * @brief Insert a delay descriptor into the Active Delay List (ADL).
+ * @brief Insert a delay event into the Active Delay List (ADL).
  *
- * The ADL is maintained in ascending order of wake-up time. This function finds
- * the correct position and inserts the node so the list remains sorted.
+ * The new event is appended to the heap and moved up until its parent wakes
+ * no later than it does.
  *
- * Assumes delayd_h is a dummy head node always present at the head of the ADL.
- *
- * @param delayd Pointer to the delay descriptor to insert.
+ * @param wakeTime System time when the U-proc should be woken.
+ * @param sup Support structure of the sleeping U-proc.
+ * @return TRUE on success, FALSE if the ADL is full.
  */
-HIDDEN void insertDelayd(delayd_t *delayd) {
-  delayd_t *prev = delayd_h;
-  delayd_t *curr = delayd_h->d_next;
-
-  /* Traverse the ADL to find the correct insertion point */
-  while (curr->d_wakeTime < delayd->d_wakeTime) {
-    prev = curr;
-    curr = curr->d_next;
+HIDDEN int insertDelayd(cpu_t wakeTime, support_t *sup) {
+  if (adlCount == ADL_SIZE) {
+    return FALSE;
   }
 
-  /* Insert delayd between prev and curr */
-  delayd->d_next = curr;
-  prev->d_next = delayd;
+  int i = adlCount++;
+  adlHeap[i].d_wakeTime = wakeTime;
+  adlHeap[i].d_supStruct = sup;
+
+  while (i > 0 && adlHeap[(i - 1) / 2].d_wakeTime > adlHeap[i].d_wakeTime) {
+    swapDelayd(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+
+  return TRUE;
 }
 
 /**
- * @brief Remove and return the first real delay descriptor in the ADL.
- *
- * This removes the node immediately after the dummy head if it exists. If the
- * ADL contains only the dummy tail, NULL is returned.
+ * @brief Remove the delay event with the earliest wake up time from a
+ * non-empty ADL.
  *
- * The caller is responsible for freeing the node (e.g., returning to free
- * list).
+ * The last event replaces the root and is moved down until neither child
+ * wakes earlier.
  *
- * @return Pointer to the first delay descriptor node, or NULL if none exist.
+ * @return Support structure of the U-proc that should be woken first.
  */
-HIDDEN delayd_t *removeDelaydHead() {
-  if (delayd_h->d_next->d_wakeTime == MAXINT) {
-    /* List is empty (only dummy head and dummy tail remain) */
-    return NULL;
+HIDDEN support_t *removeDelaydHead() {
+  support_t *sup = adlHeap[0].d_supStruct;
+
+  adlCount--;
+  adlHeap[0] = adlHeap[adlCount];
+
+  int i = 0;
+  while (TRUE) {
+    int smallest = i;
+    int left = 2 * i + 1;
+    int right = 2 * i + 2;
+    if (left < adlCount &&
+        adlHeap[left].d_wakeTime < adlHeap[smallest].d_wakeTime) {
+      smallest = left;
+    }
+    if (right < adlCount &&
+        adlHeap[right].d_wakeTime < adlHeap[smallest].d_wakeTime) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      break;
+    }
+    swapDelayd(i, smallest);
+    i = smallest;
   }
 
-  delayd_t *head = delayd_h->d_next;
-  delayd_h->d_next = head->d_next;
+  return sup;
+}
 
-  return head;
+/**
+ * @brief Swap two entries of the ADL heap.
+ */
+HIDDEN void swapDelayd(int i, int j) {
+  delayd_t tmp = adlHeap[i];
+  adlHeap[i] = adlHeap[j];
+  adlHeap[j] = tmp;
 }
@@ -3,34 +3,53 @@
  * @author Dang Truong, Loc Pham
  * @brief Implements the Active Logical Semaphore List (ALSL). This module
  * manages U-proc blocking/unblocking on shared logical semaphores via SYS19 and
- * SYS20.
+ * SYS20, broadcast wakeups via SYS23 and barriers via SYS24.
+ *
+ * The ALSL is a hash table keyed by semaphore address. Each bucket chains the
+ * per-address FIFO queues of blocked U-procs, so a V finds the oldest waiter
+ * of its semaphore without scanning waiters of other semaphores.
  * @date 2025-04-23
  */
 
 #include "../h/alsl.h"
 
+#include "../h/initProc.h"
 #include "../h/scheduler.h"
 #include "../h/sysSupport.h"
 #include "umps3/umps/libumps.h"
 
-/* Logical smepahore descriptor node */
+/* Logical semaphore descriptor node: one per blocked U-proc */
 typedef struct logicalSemd_t {
-  struct logicalSemd_t *ls_next; /* Next node in ALSL or free list */
-  struct logicalSemd_t *ls_prev; /* Previous node in ALSL (circular list) */
+  struct logicalSemd_t *ls_next; /* Next waiter (circular) or free list */
   int *ls_semAddr;               /* Logical address of shared semaphore */
   support_t *ls_supStruct;       /* Support structure of the blocked U-proc */
 } logicalSemd_t;
 
+/* Per-address FIFO queue of blocked U-procs */
+typedef struct logicalQueue_t {
+  struct logicalQueue_t *lq_next; /* Next queue in the bucket or free list */
+  int *lq_semAddr;                /* Logical address of shared semaphore */
+  logicalSemd_t *lq_tail;         /* Tail of a circular queue of waiters */
+} logicalQueue_t;
+
 /* Head of the list of unused logical semaphore descriptor nodes
  * (NULL-terminated singly linked) */
 HIDDEN logicalSemd_t *logicalSemdFree_h;
 
-/* Tail of the active logical semaphore descriptor list (double circular list)
- */
-HIDDEN logicalSemd_t *blockedUprocs;
+/* Head of the list of unused per-address queues (NULL-terminated) */
+HIDDEN logicalQueue_t *logicalQueueFree_h;
+
+/* The ALSL: a hash table of NULL-terminated chains of non-empty per-address
+ * queues, keyed by semaphore address */
+HIDDEN logicalQueue_t *alslBuckets[ALSL_BUCKETS];
 
-/* The semaphore that protects both the free list and active list */
-HIDDEN int ALSL_Semaphore;
+/* The free lists, the ALSL and the shared semaphores themselves are only
+ * touched with interrupts disabled (see lockLogicalSem): on a uniprocessor
+ * that makes each SYS19/SYS20 atomic without a mutex semaphore, so blocking
+ * costs a single Nucleus call */
+
+/* Bucket of a semaphore address (semaphores are word aligned) */
+#define ALSL_HASH(semAddr) (((memaddr)(semAddr) >> 2) & (ALSL_BUCKETS - 1))
 
 /*====================Local function declarations====================*/
 
@@ -38,12 +57,13 @@ HIDDEN void initLogicalSemd();
 HIDDEN logicalSemd_t *allocLogicalSemd();
 HIDDEN void freeLogicalSemd(logicalSemd_t *semd);
 
-HIDDEN int emptyLogicalSemdList();
-HIDDEN logicalSemd_t *headLogicalSemdList();
-
-HIDDEN logicalSemd_t *searchLogicalSemd(int *semAddr);
-HIDDEN void insertLogicalSemd(logicalSemd_t *semd);
-HIDDEN void removeLogicalSemd(logicalSemd_t *semd);
+HIDDEN void checkLogicalAddr(int *semAddr, support_t *sup);
+HIDDEN unsigned int lockLogicalSem(int *semAddr);
+HIDDEN void blockLogical(int *semAddr, support_t *sup, unsigned int status);
+HIDDEN int wakeLogical(int *semAddr);
+HIDDEN logicalQueue_t *searchLogicalQueue(int *semAddr);
+HIDDEN int insertLogicalSemd(logicalSemd_t *semd);
+HIDDEN logicalSemd_t *removeLogicalSemd(int *semAddr);
 
 /*====================Global function definitions====================*/
 
@@ -61,42 +81,20 @@ void sysPasserenLogicalSem(state_t *excState, support_t *sup) {
   int *semAddr = (int *)excState->s_a1;
 
   /* 1. Check whether the semaphore address is in the KUSEGSHARE region */
-  if ((memaddr)semAddr < KUSEGSHARE_BASE ||
-      (memaddr)semAddr >= KUSEGSHARE_BASE + KUSEGSHARE_PAGES * PAGESIZE) {
-    programTrapHandler(sup);
-  }
+  checkLogicalAddr(semAddr, sup);
 
-  /* 2. Decrement the semaphore and return control to the U-proc if the
-   * semaphore value is non-negative */
-  (*semAddr)--;
-  if (*semAddr >= 0) {
-    switchContext(excState);
-  }
-
-  /* 3. Obtain mutual exclusion over the ALSL */
-  SYSCALL(PASSEREN, (int)&ALSL_Semaphore, 0, 0);
+  /* 2. Make the semaphore's page resident and disable interrupts */
+  unsigned int status = lockLogicalSem(semAddr);
 
-  /* 4. Allocate a logical semaphore descriptor node from the list */
-  logicalSemd_t *logicalSemd = allocLogicalSemd();
-  if (logicalSemd == NULL) {
-    /* Run out of semaphore descriptors */
-    SYSCALL(VERHOGEN, (int)&ALSL_Semaphore, 0, 0);
-    programTrapHandler(sup);
+  /* 3. Decrement the semaphore and block the U-proc if the semaphore value
+   * is negative */
+  (*semAddr)--;
+  if (*semAddr < 0) {
+    blockLogical(semAddr, sup, status);
   }
-  /* Populate semaphore descriptor node and enqueue it to the ALSL */
-  logicalSemd->ls_semAddr = semAddr;
-  logicalSemd->ls_supStruct = sup;
-  insertLogicalSemd(logicalSemd);
-
-  /* 5. Release mutual exclusion over the ALSL and P on the U-proc's private
-   * semaphore atomically */
-  unsigned int status = getSTATUS();
-  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
-  SYSCALL(VERHOGEN, (int)&ALSL_Semaphore, 0, 0);
-  SYSCALL(PASSEREN, (int)&sup->sup_privateSem, 0, 0);
   setSTATUS(status); /* Reenable interrupts */
 
-  /* 6. Return control to the U-proc */
+  /* 4. Return control to the U-proc */
   switchContext(excState);
 }
 
@@ -114,43 +112,92 @@ void sysVerhogenLogicalSem(state_t *excState, support_t *sup) {
   int *semAddr = (int *)excState->s_a1;
 
   /* 1. Check whether the semaphore address is in the KUSEGSHARE region */
-  if ((memaddr)semAddr < KUSEGSHARE_BASE ||
-      (memaddr)semAddr >= KUSEGSHARE_BASE + KUSEGSHARE_PAGES * PAGESIZE) {
-    programTrapHandler(sup);
-  }
+  checkLogicalAddr(semAddr, sup);
+
+  /* 2. Make the semaphore's page resident and disable interrupts */
+  unsigned int status = lockLogicalSem(semAddr);
 
-  /* 2. Increment the semaphore and return control to the U-proc if the
-   * semaphore value is > 0 */
+  /* 3. Increment the semaphore and wake up the oldest U-proc blocked on it,
+   * if any, with a single Nucleus call */
   (*semAddr)++;
-  if (*semAddr > 0) {
-    switchContext(excState);
+  if (*semAddr <= 0) {
+    wakeLogical(semAddr);
   }
+  setSTATUS(status); /* Reenable interrupts */
 
-  /* 3. Obtain mutual exclusion over the ALSL */
-  SYSCALL(PASSEREN, (int)&ALSL_Semaphore, 0, 0);
+  /* 4. Return control to the calling U-proc */
+  switchContext(excState);
+}
 
-  /* 4. Search the ALSL for a matching semaphore address */
-  logicalSemd_t *logicalSemd = searchLogicalSemd(semAddr);
+/**
+ * @brief Perform SYS23: broadcast V on a logical address semaphore in
+ * KUSEGSHARE.
+ *
+ * Wakes every U-proc blocked on the semaphore in one syscall, as if one V had
+ * been issued per waiter. The semaphore ends at 0 if there were waiters and
+ * is left unchanged otherwise. Returns the number of U-procs woken in `s_v0`.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ */
+void sysVerhogenAllLogicalSem(state_t *excState, support_t *sup) {
+  int *semAddr = (int *)excState->s_a1;
 
-  /* 5. If no matching node is found */
-  if (logicalSemd == NULL) {
-    SYSCALL(VERHOGEN, (int)&ALSL_Semaphore, 0, 0);
-    switchContext(excState);
-  } else {
-    /* 6. Matching node found: Deallocate it and V the private semaphore */
-    support_t *blockedSup = logicalSemd->ls_supStruct;
-    removeLogicalSemd(logicalSemd);
-    freeLogicalSemd(logicalSemd);
+  checkLogicalAddr(semAddr, sup);
+  unsigned int status = lockLogicalSem(semAddr);
 
-    /* 7. Release mutual exclusion over the ALSL */
-    SYSCALL(VERHOGEN, (int)&ALSL_Semaphore, 0, 0);
+  int woken = 0;
+  while (*semAddr < 0) {
+    (*semAddr)++;
+    woken += wakeLogical(semAddr);
+  }
+  setSTATUS(status); /* Reenable interrupts */
 
-    /* Wake up the blocked process */
-    SYSCALL(VERHOGEN, (int)&blockedSup->sup_privateSem, 0, 0);
+  excState->s_v0 = woken;
+  switchContext(excState);
+}
 
-    /* 8. Return control to the calling U-proc */
-    switchContext(excState);
+/**
+ * @brief Perform SYS24: wait on a reusable barrier in KUSEGSHARE.
+ *
+ * - a1: logical address of the barrier word (initially 0); it counts the
+ *   U-procs that have arrived in the current round and must not be used as a
+ *   semaphore at the same time.
+ * - a2: number of U-procs taking part (> 0).
+ *
+ * Each caller blocks until the last one arrives. The last one resets the
+ * barrier word for the next round and releases everybody in the same syscall.
+ * Returns 1 in `s_v0` to the last U-proc to arrive and 0 to the others.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ */
+void sysBarrierLogical(state_t *excState, support_t *sup) {
+  int *barrierAddr = (int *)excState->s_a1;
+  int parties = excState->s_a2;
+
+  checkLogicalAddr(barrierAddr, sup);
+  if (parties <= 0) {
+    programTrapHandler(sup);
   }
+
+  unsigned int status = lockLogicalSem(barrierAddr);
+
+  (*barrierAddr)++;
+  if (*barrierAddr >= parties) {
+    /* Last to arrive: open the barrier and start the next round */
+    *barrierAddr = 0;
+    while (wakeLogical(barrierAddr)) {
+      ;
+    }
+    excState->s_v0 = 1;
+  } else {
+    excState->s_v0 = 0;
+    blockLogical(barrierAddr, sup, status);
+  }
+  setSTATUS(status); /* Reenable interrupts */
+
+  switchContext(excState);
 }
 
 /**
@@ -159,20 +206,24 @@ void sysVerhogenLogicalSem(state_t *excState, support_t *sup) {
  * Must be called by the Support Level Instantiator during system startup.
  */
 void initALSL() {
-  /* Allocate storage for logical semaphore descriptor nodes */
-  static logicalSemd_t logicalSemds[MAX_UPROCS];
+  /* Allocate storage for waiter nodes and per-address queues: one of each
+   * per support structure, the most that can ever be blocked at once */
+  static logicalSemd_t logicalSemds[ALSL_NODES];
+  static logicalQueue_t logicalQueues[ALSL_NODES];
 
   logicalSemdFree_h = NULL;
+  logicalQueueFree_h = NULL;
   int i;
-  for (i = 0; i < MAX_UPROCS; i++) {
+  for (i = 0; i < ALSL_NODES; i++) {
     freeLogicalSemd(&logicalSemds[i]);
+    logicalQueues[i].lq_next = logicalQueueFree_h;
+    logicalQueueFree_h = &logicalQueues[i];
   }
 
-  /* Initially, no logical semaphore descriptor nodes are in the active list */
-  blockedUprocs = NULL;
-
-  /* Mutual exclusion semaphore should be initialized to one */
-  ALSL_Semaphore = 1;
+  /* Initially, no U-proc is blocked on any logical semaphore */
+  for (i = 0; i < ALSL_BUCKETS; i++) {
+    alslBuckets[i] = NULL;
+  }
 }
 
 /*====================Local function definitions====================*/
@@ -183,7 +234,7 @@ void initALSL() {
  * @param semd The logical semaphore descriptor to initialize.
  */
 HIDDEN void initLogicalSemd(logicalSemd_t *semd) {
-  semd->ls_next = semd->ls_prev = NULL;
+  semd->ls_next = NULL;
   semd->ls_semAddr = NULL;
   semd->ls_supStruct = NULL;
 }
@@ -219,100 +270,188 @@ HIDDEN void freeLogicalSemd(logicalSemd_t *semd) {
 }
 
 /**
- * @brief Check whether the ALSL (blockedUprocs) is empty.
+ * @brief Terminate the U-proc (program trap) unless a logical semaphore
+ * address lies in the KUSEGSHARE region.
  *
- * @return 1 if empty, 0 otherwise.
+ * @param semAddr Logical address of the shared semaphore.
+ * @param sup     Support structure of the calling U-proc.
  */
-HIDDEN int emptyLogicalSemdList() { return blockedUprocs == NULL; }
+HIDDEN void checkLogicalAddr(int *semAddr, support_t *sup) {
+  if ((memaddr)semAddr < KUSEGSHARE_BASE ||
+      (memaddr)semAddr >= KUSEGSHARE_BASE + KUSEGSHARE_PAGES * PAGESIZE) {
+    programTrapHandler(sup);
+  }
+}
 
 /**
- * @brief Get the head of the ALSL (oldest blocked U-proc).
+ * @brief Disable interrupts with the page holding a shared semaphore resident.
  *
- * @return Pointer to the head node, or NULL if ALSL is empty.
+ * The semaphore is touched with interrupts enabled so that a page fault can
+ * be served by the Pager; then interrupts are disabled and the global page
+ * table is checked. If the page was evicted in between, interrupts are
+ * reenabled and the page touched again. Once this returns, no other U-proc
+ * can run and the semaphore can be read and written without faulting (a TLB
+ * refill does not block).
+ *
+ * @param semAddr Logical address of the shared semaphore (in KUSEGSHARE).
+ * @return The previous processor status, to be restored with setSTATUS.
  */
-HIDDEN logicalSemd_t *headLogicalSemdList() {
-  if (emptyLogicalSemdList()) {
-    return NULL;
+HIDDEN unsigned int lockLogicalSem(int *semAddr) {
+  unsigned int status = getSTATUS();
+  int pageIdx = ((memaddr)semAddr - KUSEGSHARE_BASE) >> VPN_SHIFT;
+  volatile int *sem = semAddr;
+
+  while (TRUE) {
+    (void)*sem;                      /* Fault the page in if needed */
+    setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+    if (globalPgTbl[pageIdx].pte_entryLO & PTE_VALID) {
+      return status;
+    }
+    setSTATUS(status); /* Evicted meanwhile: reenable interrupts and retry */
   }
-
-  return blockedUprocs->ls_next;
 }
 
 /**
- * @brief Insert a new logical semaphore descriptor into the ALSL.
+ * @brief Block the calling U-proc on a logical semaphore address. Called with
+ * interrupts disabled by lockLogicalSem.
  *
- * Inserted at the tail of the circular doubly-linked list.
+ * The U-proc is queued in the ALSL and then P's its private semaphore: the
+ * only Nucleus call on this path. Interrupts stay disabled until then, so no
+ * wakeup can slip in between. Returns once the U-proc has been woken.
  *
- * @param semd Node to be inserted.
+ * @param semAddr Logical address of the shared semaphore.
+ * @param sup     Support structure of the calling U-proc.
+ * @param status  Processor status returned by lockLogicalSem.
  */
-HIDDEN void insertLogicalSemd(logicalSemd_t *semd) {
-  if (emptyLogicalSemdList()) {
-    semd->ls_next = semd->ls_prev = semd;
-    blockedUprocs = semd;
-    return;
+HIDDEN void blockLogical(int *semAddr, support_t *sup, unsigned int status) {
+  /* Allocate a logical semaphore descriptor node from the list */
+  logicalSemd_t *logicalSemd = allocLogicalSemd();
+  if (logicalSemd == NULL) {
+    /* Run out of semaphore descriptors (cannot happen, see ALSL_NODES) */
+    setSTATUS(status);
+    programTrapHandler(sup);
   }
 
-  /* Connect the semaphore descriptor node to the head */
-  logicalSemd_t *head = headLogicalSemdList();
-  semd->ls_next = head;
-  head->ls_prev = semd;
+  /* Populate semaphore descriptor node and enqueue it to the semaphore's
+   * queue in the ALSL */
+  logicalSemd->ls_semAddr = semAddr;
+  logicalSemd->ls_supStruct = sup;
+  if (!insertLogicalSemd(logicalSemd)) {
+    /* Run out of per-address queues (cannot happen, see ALSL_NODES) */
+    freeLogicalSemd(logicalSemd);
+    setSTATUS(status);
+    programTrapHandler(sup);
+  }
 
-  /* Connect the semaphore descriptor node to the tail and update the tail
-   * pointer */
-  blockedUprocs->ls_next = semd;
-  semd->ls_prev = blockedUprocs;
-  blockedUprocs = semd;
+  SYSCALL(PASSEREN, (int)&sup->sup_privateSem, 0, 0);
 }
 
 /**
- * @brief Remove a logical semaphore descriptor from the ALSL.
+ * @brief Wake up the oldest U-proc blocked on a logical semaphore address.
+ * Called with interrupts disabled by lockLogicalSem.
  *
- * @param semd Node to be removed.
+ * @param semAddr Logical address of the shared semaphore.
+ * @return TRUE if a U-proc was woken, FALSE if none was blocked.
  */
-HIDDEN void removeLogicalSemd(logicalSemd_t *semd) {
-  if (emptyLogicalSemdList()) {
-    return;
+HIDDEN int wakeLogical(int *semAddr) {
+  logicalSemd_t *logicalSemd = removeLogicalSemd(semAddr);
+  if (logicalSemd == NULL) {
+    return FALSE;
   }
 
-  logicalSemd_t *prev = semd->ls_prev;
-  logicalSemd_t *next = semd->ls_next;
+  support_t *blockedSup = logicalSemd->ls_supStruct;
+  freeLogicalSemd(logicalSemd);
+  SYSCALL(VERHOGEN, (int)&blockedSup->sup_privateSem, 0, 0);
+  return TRUE;
+}
 
-  if (prev == semd && next == semd) {
-    /* Remove the only node in the list */
-    blockedUprocs = NULL;
-  } else {
-    /* Remove from a list with at least two nodes */
-    prev->ls_next = next;
-    next->ls_prev = prev;
+/**
+ * @brief Find the queue of U-procs blocked on a semaphore address.
+ *
+ * Only the chain of the address's hash bucket is searched.
+ *
+ * @param semAddr The logical address to search for.
+ * @return Pointer to the matching queue, or NULL if none is blocked on it.
+ */
+HIDDEN logicalQueue_t *searchLogicalQueue(int *semAddr) {
+  logicalQueue_t *queue = alslBuckets[ALSL_HASH(semAddr)];
+  while (queue != NULL && queue->lq_semAddr != semAddr) {
+    queue = queue->lq_next;
+  }
+  return queue;
+}
 
-    if (semd == blockedUprocs) {
-      /* If remove the tail node, update tail pointer */
-      blockedUprocs = prev;
+/**
+ * @brief Insert a logical semaphore descriptor at the tail of its semaphore's
+ * queue, creating the queue if it is the first waiter.
+ *
+ * @param semd Node to be inserted (ls_semAddr must be set).
+ * @return TRUE on success, FALSE if no free queue was available.
+ */
+HIDDEN int insertLogicalSemd(logicalSemd_t *semd) {
+  logicalQueue_t *queue = searchLogicalQueue(semd->ls_semAddr);
+
+  if (queue == NULL) {
+    if (logicalQueueFree_h == NULL) {
+      return FALSE;
     }
+
+    /* Take a queue from the free list and push it onto the bucket chain */
+    queue = logicalQueueFree_h;
+    logicalQueueFree_h = queue->lq_next;
+    queue->lq_semAddr = semd->ls_semAddr;
+    queue->lq_tail = NULL;
+
+    int bucket = ALSL_HASH(semd->ls_semAddr);
+    queue->lq_next = alslBuckets[bucket];
+    alslBuckets[bucket] = queue;
   }
+
+  if (queue->lq_tail == NULL) {
+    semd->ls_next = semd;
+  } else {
+    /* Link after the tail; the tail's successor is the head */
+    semd->ls_next = queue->lq_tail->ls_next;
+    queue->lq_tail->ls_next = semd;
+  }
+  queue->lq_tail = semd;
+
+  return TRUE;
 }
 
 /**
- * @brief Search the ALSL for a node matching a given semaphore logical address.
+ * @brief Remove the oldest logical semaphore descriptor blocked on a
+ * semaphore address. The semaphore's queue is released once it is empty.
  *
- * @param semAddr The logical address to search for.
- * @return Pointer to the matching node, or NULL if not found.
+ * @param semAddr The logical address of the semaphore.
+ * @return Pointer to the removed node, or NULL if none is blocked on it.
  */
-HIDDEN logicalSemd_t *searchLogicalSemd(int *semAddr) {
-  if (emptyLogicalSemdList()) {
-    return NULL;
+HIDDEN logicalSemd_t *removeLogicalSemd(int *semAddr) {
+  int bucket = ALSL_HASH(semAddr);
+  logicalQueue_t *prev = NULL;
+  logicalQueue_t *queue = alslBuckets[bucket];
+  while (queue != NULL && queue->lq_semAddr != semAddr) {
+    prev = queue;
+    queue = queue->lq_next;
   }
 
-  logicalSemd_t *cur = headLogicalSemdList();
-  logicalSemd_t *found = NULL;
+  if (queue == NULL) {
+    return NULL;
+  }
 
-  /* Iterate through the circular list and stop if there's a match */
-  do {
-    if (cur->ls_semAddr == semAddr) {
-      found = cur;
+  logicalSemd_t *head = queue->lq_tail->ls_next;
+  if (head == queue->lq_tail) {
+    /* Last waiter: unlink the queue from the bucket and free it */
+    if (prev == NULL) {
+      alslBuckets[bucket] = queue->lq_next;
+    } else {
+      prev->lq_next = queue->lq_next;
     }
-    cur = cur->ls_next;
-  } while (found == NULL && cur != headLogicalSemdList());
+    queue->lq_next = logicalQueueFree_h;
+    logicalQueueFree_h = queue;
+  } else {
+    queue->lq_tail->ls_next = head->ls_next;
+  }
 
-  return found;
+  return head;
 }
@@ -0,0 +1,213 @@
+/**
+ * @file pipe.c
+ * @author Dang Truong, Loc Pham
+ * @brief Implements kernel pipes between U-procs: NUM_PIPES bounded byte
+ * buffers of PIPE_SIZE bytes, written with SYS25 (PIPESEND) and read with
+ * SYS26 (PIPERECV). One call moves up to PIPE_MAXLEN bytes.
+ *
+ * A sender blocks while the pipe is full and a receiver while it is empty.
+ * Blocked receivers are only woken when the pipe goes from empty to non-empty
+ * and blocked senders only when it goes from full to non-full, so a stream of
+ * sends to a pipe nobody is waiting on costs no wakeups.
+ * @date 2025-05-06
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/pipe.h"
+
+#include "../h/const.h"
+#include "../h/scheduler.h"
+#include "../h/sysSupport.h"
+#include "../h/types.h"
+#include "../h/vmSupport.h"
+#include "umps3/umps/libumps.h"
+
+/* Kernel pipe: a ring buffer plus the U-procs waiting on it */
+typedef struct pipe_t {
+  char p_buf[PIPE_SIZE]; /* ring buffer                              */
+  int p_head;            /* index of the oldest unread byte          */
+  int p_count;           /* number of unread bytes                   */
+  int p_mutex;           /* mutual exclusion over this pipe          */
+  int p_readSem;         /* receivers waiting for data               */
+  int p_readWaiters;     /* number of U-procs blocked on p_readSem   */
+  int p_writeSem;        /* senders waiting for space                */
+  int p_writeWaiters;    /* number of U-procs blocked on p_writeSem  */
+} pipe_t;
+
+HIDDEN pipe_t pipes[NUM_PIPES];
+
+/*====================Local function declarations====================*/
+
+HIDDEN pipe_t *checkPipeArgs(state_t *excState, support_t *sup);
+HIDDEN void waitPipe(pipe_t *pipe, int *sem, int *waiters);
+HIDDEN void wakePipe(int *sem, int *waiters);
+
+/*====================Global function definitions====================*/
+
+/**
+ * @brief Initialize all pipes to empty with no waiters.
+ *
+ * Must be called by the Support Level Instantiator during system startup.
+ */
+void initPipes() {
+  int i;
+  for (i = 0; i < NUM_PIPES; i++) {
+    pipes[i].p_head = 0;
+    pipes[i].p_count = 0;
+    pipes[i].p_mutex = 1;
+    pipes[i].p_readSem = 0;
+    pipes[i].p_readWaiters = 0;
+    pipes[i].p_writeSem = 0;
+    pipes[i].p_writeWaiters = 0;
+  }
+}
+
+/**
+ * @brief Perform SYS25: write bytes into a pipe.
+ *
+ * - a1: pipe number (0 to NUM_PIPES - 1).
+ * - a2: virtual address of the bytes to send.
+ * - a3: number of bytes (at most PIPE_MAXLEN).
+ *
+ * Blocks until every byte has been copied into the pipe, waiting for
+ * receivers whenever it is full. Returns the number of bytes sent in `s_v0`.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ */
+void sysPipeSend(state_t *excState, support_t *sup) {
+  pipe_t *pipe = checkPipeArgs(excState, sup);
+  char *src = (char *)excState->s_a2;
+  int len = excState->s_a3;
+
+  SYSCALL(PASSEREN, (int)&pipe->p_mutex, 0, 0);
+
+  int sent = 0;
+  while (sent < len) {
+    while (pipe->p_count == PIPE_SIZE) {
+      waitPipe(pipe, &pipe->p_writeSem, &pipe->p_writeWaiters);
+    }
+
+    /* Copy as much as fits. The mutex is held, so a page fault on the
+     * U-proc's buffer only delays other users of this pipe */
+    int wasEmpty = (pipe->p_count == 0);
+    while (sent < len && pipe->p_count < PIPE_SIZE) {
+      pipe->p_buf[(pipe->p_head + pipe->p_count) % PIPE_SIZE] = src[sent];
+      pipe->p_count++;
+      sent++;
+    }
+
+    if (wasEmpty) {
+      wakePipe(&pipe->p_readSem, &pipe->p_readWaiters);
+    }
+  }
+
+  SYSCALL(VERHOGEN, (int)&pipe->p_mutex, 0, 0);
+
+  excState->s_v0 = sent;
+  switchContext(excState);
+}
+
+/**
+ * @brief Perform SYS26: read bytes from a pipe.
+ *
+ * - a1: pipe number (0 to NUM_PIPES - 1).
+ * - a2: virtual address of the destination buffer.
+ * - a3: buffer size in bytes (at most PIPE_MAXLEN).
+ *
+ * Blocks while the pipe is empty, then copies out whatever is available up to
+ * the buffer size. Returns the number of bytes received in `s_v0`.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ */
+void sysPipeReceive(state_t *excState, support_t *sup) {
+  pipe_t *pipe = checkPipeArgs(excState, sup);
+  char *dst = (char *)excState->s_a2;
+  int len = excState->s_a3;
+
+  SYSCALL(PASSEREN, (int)&pipe->p_mutex, 0, 0);
+
+  while (len > 0 && pipe->p_count == 0) {
+    waitPipe(pipe, &pipe->p_readSem, &pipe->p_readWaiters);
+  }
+
+  int wasFull = (pipe->p_count == PIPE_SIZE);
+  int received = 0;
+  while (received < len && pipe->p_count > 0) {
+    dst[received] = pipe->p_buf[pipe->p_head];
+    pipe->p_head = (pipe->p_head + 1) % PIPE_SIZE;
+    pipe->p_count--;
+    received++;
+  }
+
+  if (wasFull && received > 0) {
+    wakePipe(&pipe->p_writeSem, &pipe->p_writeWaiters);
+  }
+
+  SYSCALL(VERHOGEN, (int)&pipe->p_mutex, 0, 0);
+
+  excState->s_v0 = received;
+  switchContext(excState);
+}
+
+/*====================Local function definitions====================*/
+
+/**
+ * @brief Validate the arguments of SYS25/SYS26, terminating the U-proc
+ * (program trap) if the pipe number, length or buffer is invalid.
+ *
+ * @param excState Saved exception state of the calling U-proc.
+ * @param sup      Support structure of the calling U-proc.
+ * @return The pipe addressed by a1.
+ */
+HIDDEN pipe_t *checkPipeArgs(state_t *excState, support_t *sup) {
+  int pipeNum = excState->s_a1;
+  memaddr virtAddr = excState->s_a2;
+  /* if len < 0, then len will be a very large number due to overflow */
+  unsigned int len = excState->s_a3;
+
+  if (pipeNum < 0 || pipeNum >= NUM_PIPES || len > PIPE_MAXLEN ||
+      !isValidRange(virtAddr, len)) {
+    programTrapHandler(sup);
+  }
+
+  return &pipes[pipeNum];
+}
+
+/**
+ * @brief Release a pipe's mutex and block on one of its wait semaphores
+ * atomically, then reacquire the mutex once woken.
+ *
+ * @param pipe    The pipe whose mutex the caller holds.
+ * @param sem     The wait semaphore (p_readSem or p_writeSem).
+ * @param waiters The matching waiter count.
+ */
+HIDDEN void waitPipe(pipe_t *pipe, int *sem, int *waiters) {
+  (*waiters)++;
+
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  SYSCALL(VERHOGEN, (int)&pipe->p_mutex, 0, 0);
+  SYSCALL(PASSEREN, (int)sem, 0, 0);
+  setSTATUS(status); /* Reenable interrupts */
+
+  SYSCALL(PASSEREN, (int)&pipe->p_mutex, 0, 0);
+}
+
+/**
+ * @brief Wake every U-proc blocked on one of a pipe's wait semaphores. The
+ * caller holds the pipe's mutex; woken U-procs recheck the pipe once they
+ * reacquire it.
+ *
+ * @param sem     The wait semaphore (p_readSem or p_writeSem).
+ * @param waiters The matching waiter count.
+ */
+HIDDEN void wakePipe(int *sem, int *waiters) {
+  while (*waiters > 0) {
+    (*waiters)--;
+    SYSCALL(VERHOGEN, (int)sem, 0, 0);
+  }
+}
@@ -0,0 +1,261 @@
+/**
+ * @file thread.c
+ * @author Dang Truong, Loc Pham
+ * @brief Implements threads within a U-proc: SYS30 (THREADCREATE) starts a
+ * thread and SYS31 (THREADJOIN) waits for one to terminate.
+ *
+ * A thread is a Nucleus process with a support structure of its own, so that
+ * it has its own exception states, Support Level stacks, DMA buffer and
+ * private semaphore and can block in a syscall while the others compute. The
+ * structure carries the U-proc's ASID and device binding, and the Pager uses
+ * the Page Table of the support structure that owns the address space (see
+ * addrSpaceOwner()). Threads are created as siblings of the caller in the
+ * process tree, so that none of them is killed when another terminates.
+ *
+ * SYS9 (TERMINATE) ends only the calling thread. The U-proc's address space,
+ * spooled output and the owner's support structure are released when its last
+ * thread terminates, whichever that is.
+ * @date 2025-05-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../h/thread.h"
+
+#include "../h/const.h"
+#include "../h/initProc.h"
+#include "../h/scheduler.h"
+#include "../h/supportAlloc.h"
+#include "../h/types.h"
+#include "umps3/umps/libumps.h"
+
+/* Thread created by SYS30. The entry outlives the thread until it is joined
+ * or its U-proc terminates, so a late SYS31 still finds it */
+typedef struct thread_t {
+  support_t *t_sup; /* support structure while running, NULL afterwards */
+  int t_asid;       /* ASID of the U-proc, 0 if the entry is free        */
+  int t_exitSem;    /* V'd when the thread terminates                    */
+  int t_joined;     /* TRUE once a thread is joining it                  */
+} thread_t;
+
+/* Threads indexed by thread id - 1 */
+HIDDEN thread_t threads[MAX_THREADS];
+
+/* Per ASID: threads created by SYS30 still running, and whether the U-proc's
+ * first thread (the owner of the address space) has terminated */
+HIDDEN int createdRunning[MAX_UPROCS + 1];
+HIDDEN int ownerDone[MAX_UPROCS + 1];
+
+/*====================Local function declarations====================*/
+
+HIDDEN int findThread(support_t *sup);
+HIDDEN void freeThreads(int asid);
+
+/*====================Global function definitions====================*/
+
+/**
+ * @brief Initialize the thread table to empty.
+ *
+ * Must be called by the Support Level Instantiator during system startup.
+ */
+void initThreads() {
+  int i;
+  for (i = 0; i < MAX_THREADS; i++) {
+    threads[i].t_sup = NULL;
+    threads[i].t_asid = 0;
+  }
+  for (i = 0; i <= MAX_UPROCS; i++) {
+    createdRunning[i] = 0;
+    ownerDone[i] = FALSE;
+  }
+}
+
+/**
+ * @brief Count the threads of a U-proc that are running, including its first
+ * thread.
+ *
+ * @param asid ASID of the U-proc.
+ * @return Number of running threads.
+ */
+int threadCount(int asid) {
+  return createdRunning[asid] + (ownerDone[asid] ? 0 : 1);
+}
+
+/**
+ * @brief Record the termination of a U-proc thread (SYS9) and wake the thread
+ * joining it, if any.
+ *
+ * When the last thread of the U-proc terminates, the U-proc's threads that
+ * were never joined are forgotten as well.
+ *
+ * @param sup Support structure of the terminating thread.
+ * @return Number of threads of the U-proc still running; 0 if the caller is
+ * to release the U-proc's resources.
+ */
+int threadExit(support_t *sup) {
+  int asid = sup->sup_asid;
+
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  int idx = findThread(sup);
+  if (idx >= 0) {
+    threads[idx].t_sup = NULL;
+    createdRunning[asid]--;
+    SYSCALL(VERHOGEN, (int)&threads[idx].t_exitSem, 0, 0);
+  } else {
+    ownerDone[asid] = TRUE;
+  }
+
+  int running = threadCount(asid);
+  if (running == 0) {
+    /* Ready for the next U-proc with this ASID */
+    freeThreads(asid);
+    ownerDone[asid] = FALSE;
+  }
+  setSTATUS(status); /* Reenable interrupts */
+
+  return running;
+}
+
+/**
+ * @brief Perform SYS30: start a thread in the calling U-proc.
+ *
+ * - a1: virtual address the thread starts executing at.
+ * - a2: initial stack pointer of the thread, on a stack the U-proc set aside.
+ * - a3: argument passed to the thread in a0.
+ *
+ * The thread runs in user mode with the U-proc's ASID and devices, and ends
+ * with SYS9. Returns the thread id (1 to MAX_THREADS) in `s_v0`, or ERR if no
+ * thread entry, support structure or process is available.
+ *
+ * @param excState Saved exception state of the calling thread.
+ * @param sup      Support structure of the calling thread.
+ */
+void sysThreadCreate(state_t *excState, support_t *sup) {
+  int asid = sup->sup_asid;
+
+  /* Claim a free thread entry */
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  int idx = 0;
+  while (idx < MAX_THREADS && threads[idx].t_asid != 0) {
+    idx++;
+  }
+  if (idx < MAX_THREADS) {
+    threads[idx].t_asid = asid;
+    threads[idx].t_exitSem = 0;
+    threads[idx].t_joined = TRUE; /* Not joinable until it runs */
+  }
+  setSTATUS(status); /* Reenable interrupts */
+
+  support_t *threadSup = (idx < MAX_THREADS) ? supportAlloc() : NULL;
+  if (threadSup == NULL) {
+    if (idx < MAX_THREADS) {
+      threads[idx].t_asid = 0;
+    }
+    excState->s_v0 = ERR;
+    switchContext(excState);
+  }
+
+  /* Own stacks and exception contexts; the U-proc's address space */
+  initSupportStruct(threadSup);
+  threadSup->sup_asid = asid;
+  threadSup->sup_dev = sup->sup_dev;
+
+  state_t threadState;
+  initUProcState(&threadState, asid);
+  threadState.s_pc = threadState.s_t9 = excState->s_a1;
+  threadState.s_sp = excState->s_a2;
+  threadState.s_a0 = excState->s_a3;
+
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  threads[idx].t_sup = threadSup;
+  threads[idx].t_joined = FALSE;
+  createdRunning[asid]++;
+  setSTATUS(status); /* Reenable interrupts */
+
+  if (SYSCALL(CREATEPROCESS, (int)&threadState, (int)threadSup,
+              CREATE_SIBLING) != OK) {
+    setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+    threads[idx].t_sup = NULL;
+    threads[idx].t_joined = TRUE;
+    threads[idx].t_asid = 0;
+    createdRunning[asid]--;
+    setSTATUS(status); /* Reenable interrupts */
+
+    supportDeallocate(threadSup);
+    excState->s_v0 = ERR;
+  } else {
+    excState->s_v0 = idx + 1;
+  }
+  switchContext(excState);
+}
+
+/**
+ * @brief Perform SYS31: wait for a thread of the calling U-proc to terminate.
+ *
+ * - a1: thread id returned by SYS30.
+ *
+ * Returns at once if the thread has already terminated. A thread can be
+ * joined once; its id may then be reused. Returns OK in `s_v0`, or ERR if the
+ * id does not name an unjoined thread of the U-proc other than the caller.
+ *
+ * @param excState Saved exception state of the calling thread.
+ * @param sup      Support structure of the calling thread.
+ */
+void sysThreadJoin(state_t *excState, support_t *sup) {
+  /* if tid < 1, then idx will be a very large number */
+  unsigned int idx = excState->s_a1 - 1;
+
+  unsigned int status = getSTATUS();
+  setSTATUS(status & ~STATUS_IEC); /* Disable interrupts */
+  if (idx >= MAX_THREADS || threads[idx].t_asid != sup->sup_asid ||
+      threads[idx].t_sup == sup || threads[idx].t_joined) {
+    setSTATUS(status); /* Reenable interrupts */
+    excState->s_v0 = ERR;
+    switchContext(excState);
+  }
+  threads[idx].t_joined = TRUE;
+  setSTATUS(status); /* Reenable interrupts */
+
+  SYSCALL(PASSEREN, (int)&threads[idx].t_exitSem, 0, 0);
+
+  /* The entry is free again */
+  threads[idx].t_asid = 0;
+  excState->s_v0 = OK;
+  switchContext(excState);
+}
+
+/*====================Local function definitions====================*/
+
+/**
+ * @brief Find the entry of a running thread created by SYS30.
+ *
+ * @param sup Support structure of the thread.
+ * @return Index of the entry, or -1 if sup is the first thread of a U-proc.
+ */
+HIDDEN int findThread(support_t *sup) {
+  int i;
+  for (i = 0; i < MAX_THREADS; i++) {
+    if (threads[i].t_sup == sup) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Free the entries of a U-proc's terminated threads that were never
+ * joined. Called with interrupts disabled.
+ *
+ * @param asid ASID of the U-proc.
+ */
+HIDDEN void freeThreads(int asid) {
+  int i;
+  for (i = 0; i < MAX_THREADS; i++) {
+    if (threads[i].t_asid == asid) {
+      threads[i].t_asid = 0;
+    }
+  }
+}
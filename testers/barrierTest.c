@@ -0,0 +1,85 @@
+/*	Test of the logical barrier (SYS24). Load this program on all eight
+ *	flash devices: the eight U-procs meet at a barrier in the shared
+ *	segment 2 * ROUNDS times (two crossings per round), then the last one
+ *	to arrive reports the number of barrier rounds per second.
+ *
+ *	The barrier words rely on the shared segment starting out zeroed.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+int *barrier = (int *)(SEG3 + 0x100);
+int *roundNum = (int *)(SEG3 + 0x104);
+
+#define		NPROCS	8
+#define		ROUNDS	1000
+
+/* Convert n to a decimal string in buf (at least 11 chars) */
+void itoa(unsigned int n, char *buf) {
+	char tmp[11];
+	int i = 0, j = 0;
+
+	do {
+		tmp[i++] = '0' + (n % 10);
+		n /= 10;
+	} while (n > 0);
+
+	while (i > 0)
+		buf[j++] = tmp[--i];
+	buf[j] = '\0';
+}
+
+void main() {
+	unsigned int start, end, elapsedMs, rate;
+	int i, last, errors;
+	char num[11];
+
+	print(WRITETERMINAL, "barrierTest starts\n");
+
+	/* wait until every U-proc has started */
+	SYSCALL(BARRIERVIRT, (int) barrier, NPROCS, 0);
+
+	start = SYSCALL(GET_TOD, 0, 0, 0);
+
+	errors = 0;
+	for (i = 0; i < ROUNDS; i++) {
+		/* nobody may leave round i before everybody has entered it */
+		if (*roundNum != i)
+			errors++;
+
+		last = SYSCALL(BARRIERVIRT, (int) barrier, NPROCS, 0);
+		if (last)
+			*roundNum = i + 1;
+
+		/* make sure the round counter is updated before reading it */
+		SYSCALL(BARRIERVIRT, (int) barrier, NPROCS, 0);
+	}
+
+	end = SYSCALL(GET_TOD, 0, 0, 0);
+
+	if (errors > 0)
+		print(WRITETERMINAL, "barrierTest error: rounds overlapped\n");
+	else
+		print(WRITETERMINAL, "barrierTest ok: rounds kept in step\n");
+
+	if (last) {
+		elapsedMs = (end - start) / (SECOND / 1000);
+		if (elapsedMs == 0)
+			elapsedMs = 1;
+		rate = (ROUNDS * 1000) / elapsedMs;
+
+		print(WRITETERMINAL, "barrierTest rounds per second: ");
+		itoa(rate, num);
+		print(WRITETERMINAL, num);
+		print(WRITETERMINAL, "\n");
+	}
+
+	print(WRITETERMINAL, "barrierTest completed\n");
+
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "barrierTest error: did not terminate\n");
+	HALT();
+}
@@ -0,0 +1,18 @@
+/*	Image that execTest replaces its own with through EXEC (SYS28). Run
+ *	from its own flash device it only reports and terminates as well.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+void main() {
+	print(WRITETERMINAL, "execTarget ok: the new image runs\n");
+
+	print(WRITETERMINAL, "execTarget completed\n");
+
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "execTarget error: did not terminate\n");
+	HALT();
+}
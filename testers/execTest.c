@@ -0,0 +1,69 @@
+/*	Test of EXEC (SYS28). The calls that must fail come first and leave
+ *	the image running: a flash number out of range, the flash device
+ *	NOFLASH, which must not be installed, and a call made while a second
+ *	thread of the U-proc is alive. The last call replaces the image with
+ *	execTarget, which must be loaded on flash device EXECFLASH and reports
+ *	on this terminal that it runs.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define		EXECFLASH	1
+#define		NOFLASH		7
+#define		ERR			-1
+#define		OK			0
+
+/* Stack top of the second thread: a private page below the main stack */
+#define		STACKTOP	(SEG2 + (28 * PAGESIZE))
+
+int *release = (int *)(SEG2 + (20 * PAGESIZE));
+
+/* Stays alive until main sets *release */
+void sleeper(int unused) {
+	while (*release == 0)
+		SYSCALL(DELAY, 1, 0, 0);
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
+
+void main() {
+	int tid;
+
+	print(WRITETERMINAL, "execTest starts\n");
+
+	if (SYSCALL(EXEC, 8, 0, 0) != ERR || SYSCALL(EXEC, -1, 0, 0) != ERR)
+		print(WRITETERMINAL, "execTest error: bad flash number accepted\n");
+	else
+		print(WRITETERMINAL, "execTest ok: bad flash number refused\n");
+
+	if (SYSCALL(EXEC, NOFLASH, 0, 0) != ERR)
+		print(WRITETERMINAL, "execTest error: missing flash device accepted\n");
+	else
+		print(WRITETERMINAL, "execTest ok: missing flash device refused\n");
+
+	*release = 0;
+	tid = SYSCALL(THREADCREATE, (int) sleeper, STACKTOP, 0);
+	if (tid == ERR)
+		print(WRITETERMINAL, "execTest error: thread create failed\n");
+	else {
+		if (SYSCALL(EXEC, EXECFLASH, 0, 0) != ERR)
+			print(WRITETERMINAL, "execTest error: exec with two threads accepted\n");
+		else
+			print(WRITETERMINAL, "execTest ok: exec with two threads refused\n");
+
+		*release = 1;
+		if (SYSCALL(THREADJOIN, tid, 0, 0) != OK)
+			print(WRITETERMINAL, "execTest error: join failed\n");
+	}
+
+	/* does not return: execTarget prints the rest */
+	print(WRITETERMINAL, "execTest: replacing the image\n");
+	SYSCALL(EXEC, EXECFLASH, 0, 0);
+
+	print(WRITETERMINAL, "execTest error: exec failed\n");
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "execTest error: did not terminate\n");
+	HALT();
+}
@@ -0,0 +1,70 @@
+/*	Test of the copy-on-write FORK (SYS29). The parent fills NPAGES
+ *	private pages and forks; parent and child then write their own values
+ *	to the same pages. Each sweep over the pages of both processes needs
+ *	more frames than the Swap Pool holds for them, so the pages are forced
+ *	out of RAM as in swapStress. Before overwriting a page, each process
+ *	checks that it still holds the value it wrote there one sweep earlier,
+ *	and never the other process's.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define		FIRSTPAGE	10
+#define		NPAGES		20
+#define		SWEEPS		4
+#define		PARENTTAG	0x10000
+#define		CHILDTAG	0x20000
+
+/* First word of private page FIRSTPAGE + i */
+#define		PAGEWORD(i)	(*(int *)(SEG2 + ((FIRSTPAGE + (i)) * PAGESIZE)))
+
+void main() {
+	int i, sweep, child, tag, expected, corrupt;
+
+	print(WRITETERMINAL, "forkTest starts\n");
+
+	/* values both processes must see right after the fork */
+	for (i = 0; i < NPAGES; i++)
+		PAGEWORD(i) = i;
+
+	child = SYSCALL(FORK, 0, 0, 0);
+	if (child < 0) {
+		print(WRITETERMINAL, "forkTest error: fork failed\n");
+		SYSCALL(TERMINATE, 0, 0, 0);
+	}
+	tag = (child == 0) ? CHILDTAG : PARENTTAG;
+
+	corrupt = FALSE;
+	for (sweep = 0; sweep <= SWEEPS; sweep++) {
+		for (i = 0; i < NPAGES; i++) {
+			/* the value written one sweep earlier (or before the fork) */
+			expected = (sweep == 0) ? i : tag + (sweep - 1) * NPAGES + i;
+			if (PAGEWORD(i) != expected)
+				corrupt = TRUE;
+
+			if (sweep < SWEEPS)
+				PAGEWORD(i) = tag + sweep * NPAGES + i;
+		}
+	}
+
+	if (child == 0) {
+		if (corrupt)
+			print(WRITETERMINAL, "forkTest error: child lost its data\n");
+		else
+			print(WRITETERMINAL, "forkTest ok: child kept its own data\n");
+	} else {
+		if (corrupt)
+			print(WRITETERMINAL, "forkTest error: parent lost its data\n");
+		else
+			print(WRITETERMINAL, "forkTest ok: parent kept its own data\n");
+	}
+
+	print(WRITETERMINAL, "forkTest completed\n");
+
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "forkTest error: did not terminate\n");
+	HALT();
+}
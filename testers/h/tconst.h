@@ -31,6 +31,17 @@
 #define DELAY			18
 #define PSEMVIRT		19
 #define VSEMVIRT		20
+#define PRINTFLUSH		21
+#define PRINTSTATS		22
+#define VSEMVIRTALL		23
+#define BARRIERVIRT		24
+#define PIPESEND		25
+#define PIPERECV		26
+#define DELAYUS			27
+#define EXEC			28
+#define FORK			29
+#define THREADCREATE		30
+#define THREADJOIN		31
 
 #define SEG0			0x00000000
 #define SEG1			0x40000000
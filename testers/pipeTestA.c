@@ -0,0 +1,42 @@
+/*	Test of the kernel pipes (SYS25/SYS26). pipeTestA (producer) sends
+ *	a known byte pattern through pipe 0, several times the pipe's capacity,
+ *	so it has to block while pipeTestB (consumer) drains the pipe.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define		PIPENUM		0
+#define		NBYTES		4096
+#define		CHUNK		500
+
+void main() {
+	char buf[CHUNK];
+	int sent, n, i;
+
+	print(WRITETERMINAL, "pipeTestA starts\n");
+
+	sent = 0;
+	while (sent < NBYTES) {
+		n = NBYTES - sent;
+		if (n > CHUNK)
+			n = CHUNK;
+		for (i = 0; i < n; i++)
+			buf[i] = (char) ((sent + i) % 251);
+
+		if (SYSCALL(PIPESEND, PIPENUM, (int) buf, n) != n) {
+			print(WRITETERMINAL, "pipeTestA error: short send\n");
+			break;
+		}
+		sent += n;
+	}
+
+	print(WRITETERMINAL, "pipeTestA completed\n");
+
+	/* terminate normally */
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "pipeTestA error: did not terminate\n");
+	HALT();
+}
@@ -0,0 +1,44 @@
+/*	Test of the kernel pipes (SYS25/SYS26). pipeTestB (consumer) reads
+ *	the byte pattern pipeTestA (producer) sends through pipe 0, using a
+ *	buffer smaller than the producer's writes, and checks every byte.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define		PIPENUM		0
+#define		NBYTES		4096
+#define		BUFSIZE		256
+
+void main() {
+	char buf[BUFSIZE];
+	int received, n, i, errors;
+
+	print(WRITETERMINAL, "pipeTestB starts\n");
+
+	received = 0;
+	errors = 0;
+	while (received < NBYTES) {
+		/* blocks until pipeTestA has sent something */
+		n = SYSCALL(PIPERECV, PIPENUM, (int) buf, BUFSIZE);
+		for (i = 0; i < n; i++) {
+			if (buf[i] != (char) ((received + i) % 251))
+				errors++;
+		}
+		received += n;
+	}
+
+	if (errors > 0 || received != NBYTES)
+		print(WRITETERMINAL, "pipeTestB error: data corrupted\n");
+	else
+		print(WRITETERMINAL, "pipeTestB ok: data received in order\n");
+
+	print(WRITETERMINAL, "pipeTestB completed\n");
+
+	/* terminate normally */
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "pipeTestB error: did not terminate\n");
+	HALT();
+}
@@ -0,0 +1,110 @@
+/*	Test of threads within a U-proc (SYS30/SYS31). Two worker threads
+ *	share the U-proc's private pages: each reads the values the main
+ *	thread wrote to NPAGES pages and then fills its own half of a common
+ *	page, ITERS times. A third thread terminates at once and is joined
+ *	only well after it has exited; it can be joined once and no more.
+ */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define		FIRSTPAGE	10
+#define		NPAGES		10
+#define		ITERS		200
+#define		SLOTS		512	/* words of the common page per worker */
+#define		ERR			-1
+#define		OK			0
+
+/* First word of private page FIRSTPAGE + i, written by the main thread */
+#define		PAGEWORD(i)	(*(int *)(SEG2 + ((FIRSTPAGE + (i)) * PAGESIZE)))
+
+/* Page both workers write to, and one word per thread to report to main */
+int *common = (int *)(SEG2 + (20 * PAGESIZE));
+int *result = (int *)(SEG2 + (21 * PAGESIZE));
+
+/* Stack tops of the threads: one private page each, below the main stack */
+#define		STACKTOP(n)	(SEG2 + ((27 + (n)) * PAGESIZE))
+
+/* Worker n (1 or 2): checks the main thread's pages and fills its half of
+ * the common page, then records the number of mismatches in result[n] */
+void worker(int n) {
+	int iter, i, errors;
+	int *mine = common + (n - 1) * SLOTS;
+
+	errors = 0;
+	for (iter = 0; iter < ITERS; iter++) {
+		for (i = 0; i < NPAGES; i++)
+			if (PAGEWORD(i) != i)
+				errors++;
+
+		for (i = 0; i < SLOTS; i++) {
+			if (iter > 0 && mine[i] != n * ITERS + iter - 1)
+				errors++;
+			mine[i] = n * ITERS + iter;
+		}
+	}
+
+	result[n] = errors;
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
+
+/* Terminates right away, after telling main it has run */
+void quitter(int n) {
+	result[n] = 1;
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
+
+void main() {
+	int i, quitId, id1, id2, errors;
+
+	print(WRITETERMINAL, "threadTest starts\n");
+
+	for (i = 0; i < NPAGES; i++)
+		PAGEWORD(i) = i;
+	result[0] = 0;
+
+	quitId = SYSCALL(THREADCREATE, (int) quitter, STACKTOP(0), 0);
+	id1 = SYSCALL(THREADCREATE, (int) worker, STACKTOP(1), 1);
+	id2 = SYSCALL(THREADCREATE, (int) worker, STACKTOP(2), 2);
+	if (quitId == ERR || id1 == ERR || id2 == ERR) {
+		print(WRITETERMINAL, "threadTest error: thread create failed\n");
+		SYSCALL(TERMINATE, 0, 0, 0);
+	}
+
+	errors = 0;
+	if (SYSCALL(THREADJOIN, id1, 0, 0) != OK ||
+		SYSCALL(THREADJOIN, id2, 0, 0) != OK)
+		print(WRITETERMINAL, "threadTest error: join failed\n");
+	else {
+		/* the workers' results and their last values in the common page */
+		errors = result[1] + result[2];
+		for (i = 0; i < SLOTS; i++)
+			if (common[i] != 2 * ITERS - 1 || common[SLOTS + i] != 3 * ITERS - 1)
+				errors++;
+
+		if (errors > 0)
+			print(WRITETERMINAL, "threadTest error: shared pages corrupted\n");
+		else
+			print(WRITETERMINAL, "threadTest ok: threads shared their pages\n");
+	}
+
+	/* make sure the quitter has run and had time to terminate */
+	while (result[0] == 0)
+		SYSCALL(DELAY, 1, 0, 0);
+	SYSCALL(DELAY, 1, 0, 0);
+
+	if (SYSCALL(THREADJOIN, quitId, 0, 0) != OK)
+		print(WRITETERMINAL, "threadTest error: join after exit failed\n");
+	else if (SYSCALL(THREADJOIN, quitId, 0, 0) != ERR)
+		print(WRITETERMINAL, "threadTest error: thread joined twice\n");
+	else
+		print(WRITETERMINAL, "threadTest ok: joined a thread after it exited\n");
+
+	print(WRITETERMINAL, "threadTest completed\n");
+
+	SYSCALL(TERMINATE, 0, 0, 0);
+
+	print(WRITETERMINAL, "threadTest error: did not terminate\n");
+	HALT();
+}